@@ -34,10 +34,20 @@ All text above, and the splash screen must be included in any redistribution
 #include "project.h"
 #include "gfxfont.h"
 
+#include "FreeRTOS.h"
+#include "semphr.h"
+
 #define BLACK 0
 #define WHITE 1
 #define INVERSE 2
 
+// Raster ops for SSD1306_blit(): how each image bit changes the screen
+#define SSD1306_BLIT_COPY    0  // Set bits on, clear bits off
+#define SSD1306_BLIT_OR      1  // Set bits on
+#define SSD1306_BLIT_AND     2  // Clear bits off
+#define SSD1306_BLIT_XOR     3  // Set bits inverted
+#define SSD1306_BLIT_ANDNOT  4  // Set bits off
+
 #define SSD1306_I2C_ADDRESS   0x3C  // 011110+SA0 - 0x3C or 0x3D
 // Address for 128x32 is 0x3C
 // Address for 128x64 is 0x3D (default) or 0x3C (if SA0 is grounded)
@@ -82,6 +92,70 @@ All text above, and the splash screen must be included in any redistribution
 #endif
 
 #define SSD1306_RAM_MIRROR_SIZE (SSD1306_LCDWIDTH * SSD1306_LCDHEIGHT / 8)
+#define SSD1306_PAGES           (SSD1306_LCDHEIGHT >> 3)
+
+// Data bytes per I2C transaction when flushing.  0 sends each address
+// window as a single transaction.
+#define SSD1306_DEFAULT_CHUNK_SIZE 0
+
+// Command bytes queued before SSD1306_commandCommit() is forced
+#define SSD1306_CMD_BUFFER_SIZE 32
+
+// Keep a shadow copy of the panel's GDDRAM and only send the bytes of the
+// dirty spans that actually differ from it.  Costs another
+// SSD1306_RAM_MIRROR_SIZE bytes of RAM.
+//#define SSD1306_SHADOW_DIFF
+
+// Rough bus cost, in bytes, of opening an extra address window: the
+// command transaction plus restarting the data transaction.  Unchanged
+// gaps up to this long are resent rather than split into two windows.
+#define SSD1306_WINDOW_COST 11
+
+// Give each panel a front buffer, so SSD1306_displayAsync() can return
+// while a FreeRTOS task sends the frame and panels sharing a bus take
+// turns a window at a time.  Costs another SSD1306_RAM_MIRROR_SIZE bytes
+// of RAM per panel.  Without it, SSD1306_displayAsync() flushes in place
+// like SSD1306_display().
+//#define SSD1306_ASYNC_FLUSH
+
+// Task sending the frames queued by SSD1306_displayAsync() for all panels.
+// The stack is in words.  The flush itself, down through the transport
+// and the i2cRegisters engine, needs around 100 of them; flush callbacks
+// run on this stack too and get the rest, so keep them to waking another
+// task, or raise this to suit.
+#define SSD1306_FLUSH_TASK_PRIORITY (tskIDLE_PRIORITY + 1)
+#define SSD1306_FLUSH_TASK_STACK    256
+
+// Leave out the built-in default instance and the plain SSD1306_* API, for
+// firmware that only uses the SSD1306_dev_* functions
+//#define SSD1306_NO_DEFAULT
+
+// Classic font glyphs kept pre-transposed for rotated text, per panel.
+// 10 bytes each, 0 to transpose them as they are drawn.
+#define SSD1306_GLYPH_CACHE_SIZE 32
+
+// Glyphs SSD1306_print() lays out before drawing them
+#define SSD1306_TEXT_BATCH 16
+
+// GFXfont SSD1306_getTextBounds() results remembered per panel, 24 bytes
+// each, 0 to measure every time
+#define SSD1306_MEASURE_CACHE_SIZE 8
+
+// Most vertices SSD1306_fillPolygon() takes, 12 bytes of stack each
+#define SSD1306_MAX_POLYGON 16
+
+// Retained widgets per panel, 52 bytes each, 0 to leave widgets out
+#define SSD1306_MAX_WIDGETS 8
+
+// Keep the images SSD1306_drawBitmap() and SSD1306_drawXBitmap() draw
+// converted to the panel's layout, keyed on the bitmap pointer, so each is
+// only converted once per rotation.  Up to SSD1306_BITMAP_CACHE_SIZE
+// images share SSD1306_BITMAP_CACHE_BYTES of RAM per panel, and larger
+// ones are converted every time.  A bitmap changed in place must be
+// dropped with SSD1306_forgetBitmaps().
+//#define SSD1306_BITMAP_CACHE
+#define SSD1306_BITMAP_CACHE_SIZE  8
+#define SSD1306_BITMAP_CACHE_BYTES 512
 
 #define SSD1306_PIXEL_ADDR(x, y) ((x) + ((y) >> 3) * SSD1306_LCDWIDTH)
 #define SSD1306_PIXEL_MASK(y)	 (1 << ((y) & 0x07))
@@ -132,12 +206,404 @@ All text above, and the splash screen must be included in any redistribution
 #define SSD1306_VERTICAL_AND_RIGHT_HORIZONTAL_SCROLL 0x29
 #define SSD1306_VERTICAL_AND_LEFT_HORIZONTAL_SCROLL 0x2A
 
+typedef struct {
+    uint16 dirty_bytes;     // Last flush: bytes covered by dirty spans
+    uint16 sent_bytes;      // Last flush: data bytes actually sent
+    uint16 windows;         // Last flush: address windows opened
+    uint16 errors;          // Last flush: transactions the transport failed
+    uint32 total_saved;     // Dirty bytes skipped since the last reset
+} SSD1306_flushStats_t;
+
+// A screen area in logical (rotated) coordinates; empty when w or h is 0
+typedef struct {
+    int16 x;
+    int16 y;
+    uint16 w;
+    uint16 h;
+} SSD1306_rect_t;
+
+// A point in logical (rotated) coordinates
+typedef struct {
+    int16 x;
+    int16 y;
+} SSD1306_point_t;
+
 typedef enum {
     SET_BITS,
     CLEAR_BITS,
     TOGGLE_BITS,
 } oper_t;
 
+/*=========================================================================
+    Display context
+    -----------------------------------------------------------------------
+    Everything about one panel: transport, framebuffer, geometry and text
+    state.  Every SSD1306_dev_* function takes one of these, so a single
+    image can drive several panels, on one bus or several.  The plain
+    SSD1306_* functions operate on a built-in default instance.
+
+    Geometry is set per instance with SSD1306_dev_setGeometry(), up to the
+    size selected above, which sizes the buffers.
+    -----------------------------------------------------------------------*/
+
+// How a panel's bytes get to the bus.  SSD1306_i2cTransport uses the
+// i2cRegisters functions; supply your own for a panel on another bus.
+typedef struct {
+    void (*write_buffer)(uint8 addr, uint8 regnum, uint8 *buffer, uint16 len);
+    void (*stream_begin)(uint8 addr, uint8 regnum);
+    void (*stream_write)(uint8 *buffer, uint16 len);
+    uint8 (*stream_end)(void);      // I2C_XFER_OK once the data went out
+} SSD1306_transport_t;
+
+extern const SSD1306_transport_t SSD1306_i2cTransport;
+
+typedef struct {
+    uint8 c;
+    uint8 rotation;
+    uint8 cols[8];
+} SSD1306_glyphCache_t;
+
+// A bitmap kept converted to raw page layout, at offset in the panel's
+// bitmap pool
+typedef struct {
+    const uint8 *bitmap;    // NULL for an unused entry
+    int16 w;
+    int16 h;
+    uint8 xbm;              // Drawn by drawXBitmap(), least significant bit first
+    uint8 rotation;
+    uint16 offset;
+    uint16 len;
+} SSD1306_bitmapCache_t;
+
+// A remembered SSD1306_getTextBounds() call.  Keyed on everything the
+// result depends on; the string itself is represented by its length and
+// FNV-1a hash, so a hit still reads the string once, but looks up no
+// glyphs.
+#define SSD1306_MEASURE_WRAP    0x01
+#define SSD1306_MEASURE_UTF8    0x02    // Decoded through a GFXfontEx
+
+typedef struct {
+    const GFXfont *font;
+    uint32 hash;
+    uint16 len;
+    int16 x;
+    int16 y;
+    int16 width;            // Screen width, which wrapping depends on
+    uint8 size;
+    uint8 flags;            // SSD1306_MEASURE_*
+    int16 x1;
+    int16 y1;
+    uint16 w;
+    uint16 h;
+} SSD1306_measure_t;
+
+// One line of SSD1306_layoutText() output
+typedef struct {
+    uint16 start;           // Offset of the line's first character
+    uint16 len;             // Characters on the line, excluding the newline
+    int16 x1;               // Left edge of the ink, relative to where the line starts
+    uint16 w;               // Width of the ink, 0 for an empty line
+} SSD1306_textLine_t;
+
+// A strip chart: the last w samples plotted across a w x h area, newest
+// on the right, one column per sample.  The caller owns the sample ring.
+typedef struct {
+    int16 x;
+    int16 y;
+    uint8 w;
+    uint8 h;
+    int16 *samples;         // Ring of w + 1 samples
+    uint8 head;             // Slot the next sample goes in
+    uint8 count;            // Samples held, up to w + 1
+    uint8 autoscale;        // Fit min/max to the samples shown
+    int16 min;              // Value plotted on the bottom row
+    int16 max;              // Value plotted on the top row
+    uint16 color;
+    uint16 bg;
+} SSD1306_chart_t;
+
+// Kinds of retained widget
+#define SSD1306_WIDGET_LABEL 0  // Text
+#define SSD1306_WIDGET_VALUE 1  // Fixed point number
+#define SSD1306_WIDGET_BAR   2  // Horizontal bar gauge
+#define SSD1306_WIDGET_ICON  3  // drawBitmap() image
+
+// A retained widget: an area of the screen redrawn from its last value
+// only when that value changes
+typedef struct {
+    SSD1306_rect_t rect;
+    uint8 type;
+    uint8 invalid;          // Needs redrawing at the next update
+    uint8 size;             // Text size
+    uint8 decimals;         // Value: digits after the point
+    int16 baseline;         // Text: baseline below the top of rect
+    int16 indent;           // Text: cursor right of the left of rect
+    const GFXfont *font;    // Text: font, NULL for the classic one
+    const GFXfontEx *fontEx;    // Text: set when font is a GFXfontEx's
+    uint16 color;
+    uint16 bg;
+    const char *text;       // Label: text
+    const uint8 *bitmap;    // Icon: image
+    uint32 hash;            // Label: FNV-1a hash of the text last set
+    int32 value;            // Value, or bar level
+    int32 min;              // Bar: level of an empty bar
+    int32 max;              // Bar: level of a full bar
+} SSD1306_widget_t;
+
+typedef struct SSD1306_s {
+    // Transport
+    const SSD1306_transport_t *transport;
+    uint8 i2caddr;
+    int8 vccstate;
+    uint16 chunk_size;
+    uint8 cmd_buf[SSD1306_CMD_BUFFER_SIZE];
+    uint8 cmd_len;
+
+    // Framebuffer and geometry
+    uint8 draw_cache[SSD1306_RAM_MIRROR_SIZE];
+    uint8 show_logo;
+    int16 WIDTH;            // Raw display size, set by setGeometry()
+    int16 HEIGHT;           // Raw display size, set by setGeometry()
+    int16 width;            // modified by current rotation
+    int16 height;           // modified by current rotation
+    uint8 rotation;
+    // Logical to raw transform for the rotation, set by setRotation():
+    // raw x = rot_x0 + rot_xx * x + rot_xy * y, and likewise for y
+    int16 rot_x0;
+    int16 rot_y0;
+    int8 rot_xx;
+    int8 rot_xy;
+    int8 rot_yx;
+    int8 rot_yy;
+
+    // Per-page dirty column span.  A page is clean when x0 > x1.
+    uint8 dirty_x0[SSD1306_PAGES];
+    uint8 dirty_x1[SSD1306_PAGES];
+
+    // Text state
+    int16 cursor_x;
+    int16 cursor_y;
+    uint16 textcolor;
+    uint16 textbgcolor;
+    uint8 textsize;
+    int wrap;
+    int cp437;              // if set, use correct CP437 characterset (default off)
+    GFXfont *gfxFont;
+    const GFXfontEx *gfxFontEx;     // Set when gfxFont has a sparse index
+
+    // UTF-8 sequence being decoded by write() for a GFXfontEx
+    uint16 utf8_cp;
+    uint8 utf8_pending;
+
+#if SSD1306_GLYPH_CACHE_SIZE
+    // Classic font glyphs as raw column bytes for a non-zero rotation
+    SSD1306_glyphCache_t glyph_cache[SSD1306_GLYPH_CACHE_SIZE];
+#endif
+
+#if SSD1306_MEASURE_CACHE_SIZE
+    // Recent text measurements, replaced round robin
+    SSD1306_measure_t measure_cache[SSD1306_MEASURE_CACHE_SIZE];
+    uint8 measure_next;
+#endif
+
+#ifdef SSD1306_BITMAP_CACHE
+    // Converted bitmaps, replaced round robin, and the pool they live in,
+    // filled as a ring from pool_next
+    SSD1306_bitmapCache_t bitmap_cache[SSD1306_BITMAP_CACHE_SIZE];
+    uint8 bitmap_next;
+    uint16 bitmap_pool_next;
+    uint8 bitmap_pool[SSD1306_BITMAP_CACHE_BYTES];
+#endif
+
+#if SSD1306_MAX_WIDGETS
+    // Retained widgets, and whether any of them needs redrawing
+    SSD1306_widget_t widgets[SSD1306_MAX_WIDGETS];
+    uint8 widget_count;
+    uint8 widgets_invalid;
+#endif
+
+    // Terminal mode: the page shown at the top of the panel, and the one
+    // the panel was last told to show
+    uint8 term;
+    uint8 start_page;
+    uint8 start_shown;
+
+    // Flush in progress: source buffer, its dirty spans, the next page and
+    // the start page to set once it is sent (0xFF for none)
+    uint8 *flush_cache;
+    uint8 *flush_x0;
+    uint8 *flush_x1;
+    uint8 flush_page;
+    uint8 flush_start;
+    SSD1306_flushStats_t stats;
+
+    // Held while a frame is being sent
+    SemaphoreHandle_t flush_idle;
+    void (*flush_callback)(void *arg);
+    void *flush_callback_arg;
+
+#ifdef SSD1306_ASYNC_FLUSH
+    // Async flush: the front buffer and its dirty spans belong to the
+    // flush task from SSD1306_dev_displayAsync() until flush_idle is given
+    // back.
+    uint8 front_cache[SSD1306_RAM_MIRROR_SIZE];
+    uint8 front_x0[SSD1306_PAGES];
+    uint8 front_x1[SSD1306_PAGES];
+    volatile uint8 flush_pending;
+    struct SSD1306_s *flush_next;
+#endif
+
+#ifdef SSD1306_SHADOW_DIFF
+    // What the panel's GDDRAM holds, as of the last flush.  Invalid until
+    // the first full frame after SSD1306_dev_begin() has been sent.
+    uint8 shadow[SSD1306_RAM_MIRROR_SIZE];
+    uint8 shadow_valid;
+#endif
+} SSD1306_t;
+
+void SSD1306_dev_initialize(SSD1306_t *dev);
+void SSD1306_dev_setAddress(SSD1306_t *dev, uint8 i2caddr);
+void SSD1306_dev_setTransport(SSD1306_t *dev, const SSD1306_transport_t *transport);
+void SSD1306_dev_setGeometry(SSD1306_t *dev, int16 w, int16 h);
+void SSD1306_dev_setVccstate(SSD1306_t *dev, uint8 vccstate);
+void SSD1306_dev_reset(SSD1306_t *dev);
+
+void SSD1306_dev_begin(SSD1306_t *dev);
+
+void SSD1306_dev_commandBegin(SSD1306_t *dev);
+void SSD1306_dev_command(SSD1306_t *dev, uint8 c);
+void SSD1306_dev_commandCommit(SSD1306_t *dev);
+
+void SSD1306_dev_displayOff(SSD1306_t *dev);
+void SSD1306_dev_displayOn(SSD1306_t *dev);
+void SSD1306_dev_clearDisplay(SSD1306_t *dev);
+void SSD1306_dev_invertDisplay(SSD1306_t *dev, uint8 i);
+void SSD1306_dev_display(SSD1306_t *dev);
+void SSD1306_dev_setFlushChunkSize(SSD1306_t *dev, uint16 size);
+
+void SSD1306_dev_displayAsync(SSD1306_t *dev);
+int SSD1306_dev_displayWait(SSD1306_t *dev, TickType_t ticks);
+void SSD1306_dev_setFlushCallback(SSD1306_t *dev, void (*callback)(void *arg), void *arg);
+
+void SSD1306_dev_getFlushStats(SSD1306_t *dev, SSD1306_flushStats_t *stats);
+void SSD1306_dev_resetFlushStats(SSD1306_t *dev);
+
+int SSD1306_dev_isDirty(SSD1306_t *dev);
+int SSD1306_dev_getDirtyRange(SSD1306_t *dev, uint8 page, uint8 *x0, uint8 *x1);
+void SSD1306_dev_markDirty(SSD1306_t *dev);
+void SSD1306_dev_clearDirty(SSD1306_t *dev);
+
+void SSD1306_dev_startScrollRight(SSD1306_t *dev, uint8 start, uint8 stop);
+void SSD1306_dev_startScrollLeft(SSD1306_t *dev, uint8 start, uint8 stop);
+
+void SSD1306_dev_startScrollDiagRight(SSD1306_t *dev, uint8 start, uint8 stop);
+void SSD1306_dev_startScrollDiagLeft(SSD1306_t *dev, uint8 start, uint8 stop);
+void SSD1306_dev_stopScroll(SSD1306_t *dev);
+
+void SSD1306_dev_dim(SSD1306_t *dev, int dim);
+
+void SSD1306_dev_drawPixel(SSD1306_t *dev, int16 x, int16 y, uint16 color);
+
+void SSD1306_dev_drawFastVLine(SSD1306_t *dev, int16 x, int16 y, int16 h, uint16 color);
+void SSD1306_dev_drawFastHLine(SSD1306_t *dev, int16 x, int16 y, int16 w, uint16 color);
+
+void SSD1306_dev_drawLine(SSD1306_t *dev, int16 x0, int16 y0, int16 x1, int16 y1, uint16 color);
+void SSD1306_dev_drawRect(SSD1306_t *dev, int16 x, int16 y, int16 w, int16 h, uint16 color);
+void SSD1306_dev_fillRect(SSD1306_t *dev, int16 x, int16 y, int16 w, int16 h, uint16 color);
+void SSD1306_dev_fillScreen(SSD1306_t *dev, uint16 color);
+SSD1306_rect_t SSD1306_dev_scrollRegion(SSD1306_t *dev, int16 x, int16 y, int16 w, int16 h,
+      int16 dx, int16 dy, uint16 fill);
+void SSD1306_dev_chartBegin(SSD1306_t *dev, SSD1306_chart_t *chart, int16 x, int16 y,
+      uint8 w, uint8 h, int16 *samples, int16 min, int16 max, uint16 color, uint16 bg);
+void SSD1306_dev_chartPush(SSD1306_t *dev, SSD1306_chart_t *chart, int16 value);
+void SSD1306_dev_chartRedraw(SSD1306_t *dev, SSD1306_chart_t *chart);
+
+void SSD1306_dev_drawCircle(SSD1306_t *dev, int16 x0, int16 y0, int16 r, uint16 color);
+void SSD1306_dev_drawCircleHelper(SSD1306_t *dev, int16 x0, int16 y0, int16 r,
+      uint8 cornername, uint16 color);
+
+void SSD1306_dev_fillCircle(SSD1306_t *dev, int16 x0, int16 y0, int16 r, uint16 color);
+void SSD1306_dev_fillCircleHelper(SSD1306_t *dev, int16 x0, int16 y0, int16 r, uint8 cornername,
+      int16 delta, uint16 color);
+void SSD1306_dev_fillEllipse(SSD1306_t *dev, int16 x0, int16 y0, int16 rx, int16 ry,
+      uint16 color);
+void SSD1306_dev_fillArc(SSD1306_t *dev, int16 x0, int16 y0, int16 r, int16 thickness,
+      int16 start, int16 end, uint16 color);
+void SSD1306_dev_fillPie(SSD1306_t *dev, int16 x0, int16 y0, int16 r,
+      int16 start, int16 end, uint16 color);
+void SSD1306_dev_drawTriangle(SSD1306_t *dev, int16 x0, int16 y0, int16 x1, int16 y1,
+      int16 x2, int16 y2, uint16 color);
+void SSD1306_dev_fillTriangle(SSD1306_t *dev, int16 x0, int16 y0, int16 x1, int16 y1,
+      int16 x2, int16 y2, uint16 color);
+void SSD1306_dev_fillPolygon(SSD1306_t *dev, const SSD1306_point_t *points, uint8 count,
+      uint16 color);
+void SSD1306_dev_drawRoundRect(SSD1306_t *dev, int16 x0, int16 y0, int16 w, int16 h,
+      int16 radius, uint16 color);
+void SSD1306_dev_fillRoundRect(SSD1306_t *dev, int16 x0, int16 y0, int16 w, int16 h,
+      int16 radius, uint16 color);
+void SSD1306_dev_drawBitmap(SSD1306_t *dev, int16 x, int16 y, uint8 *bitmap,
+      int16 w, int16 h, uint16 color, uint16 bg);
+void SSD1306_dev_drawXBitmap(SSD1306_t *dev, int16 x, int16 y, const uint8 *bitmap,
+      int16 w, int16 h, uint16 color);
+void SSD1306_dev_blit(SSD1306_t *dev, int16 x, int16 y, const uint8 *bitmap,
+      const uint8 *mask, int16 w, int16 h, uint8 op);
+void SSD1306_dev_forgetBitmaps(SSD1306_t *dev);
+void SSD1306_dev_drawChar(SSD1306_t *dev, int16 x, int16 y, uint16 c, uint16 color,
+      uint16 bg, uint8 size);
+void SSD1306_dev_setCursor(SSD1306_t *dev, int16 x, int16 y);
+void SSD1306_dev_setTextColor(SSD1306_t *dev, uint16 c, uint16 bg);
+void SSD1306_dev_setTextSize(SSD1306_t *dev, uint8 s);
+void SSD1306_dev_setTextWrap(SSD1306_t *dev, int w);
+void SSD1306_dev_setRotation(SSD1306_t *dev, uint8 r);
+void SSD1306_dev_cp437(SSD1306_t *dev, int x);
+void SSD1306_dev_setFont(SSD1306_t *dev, const GFXfont *f);
+void SSD1306_dev_setFontEx(SSD1306_t *dev, const GFXfontEx *f);
+void SSD1306_dev_getTextBounds(SSD1306_t *dev, char *string, int16 x, int16 y,
+      int16 *x1, int16 *y1, uint16 *w, uint16 *h);
+uint8 SSD1306_dev_layoutText(SSD1306_t *dev, const char *str, int16 x,
+      SSD1306_textLine_t *lines, uint8 maxLines);
+
+size_t SSD1306_dev_write(SSD1306_t *dev, uint8 c);
+void SSD1306_dev_terminalBegin(SSD1306_t *dev);
+void SSD1306_dev_terminalEnd(SSD1306_t *dev);
+SSD1306_rect_t SSD1306_dev_print(SSD1306_t *dev, const char *str, size_t len);
+SSD1306_rect_t SSD1306_dev_printAt(SSD1306_t *dev, int16 x, int16 y, const char *str, size_t len);
+SSD1306_rect_t SSD1306_dev_printInt(SSD1306_t *dev, int32 value, uint8 width, char pad);
+SSD1306_rect_t SSD1306_dev_printFixed(SSD1306_t *dev, int32 value, uint8 decimals,
+      uint8 width, char pad);
+SSD1306_rect_t SSD1306_dev_printHex(SSD1306_t *dev, uint32 value, uint8 width, char pad);
+
+#if SSD1306_MAX_WIDGETS
+int8 SSD1306_dev_addLabel(SSD1306_t *dev, int16 x, int16 y, int16 w, int16 h, const char *text);
+int8 SSD1306_dev_addValue(SSD1306_t *dev, int16 x, int16 y, int16 w, int16 h, uint8 decimals);
+int8 SSD1306_dev_addBar(SSD1306_t *dev, int16 x, int16 y, int16 w, int16 h,
+      uint16 color, uint16 bg, int32 min, int32 max);
+int8 SSD1306_dev_addIcon(SSD1306_t *dev, int16 x, int16 y, int16 w, int16 h,
+      uint16 color, uint16 bg, const uint8 *bitmap);
+void SSD1306_dev_setWidgetText(SSD1306_t *dev, int8 id, const char *text);
+void SSD1306_dev_setWidgetValue(SSD1306_t *dev, int8 id, int32 value);
+void SSD1306_dev_setWidgetBitmap(SSD1306_t *dev, int8 id, const uint8 *bitmap);
+void SSD1306_dev_invalidate(SSD1306_t *dev, int16 x, int16 y, int16 w, int16 h);
+uint8 SSD1306_dev_updateWidgets(SSD1306_t *dev);
+void SSD1306_dev_clearWidgets(SSD1306_t *dev);
+#endif
+
+int16 SSD1306_dev_height(SSD1306_t *dev);
+int16 SSD1306_dev_width(SSD1306_t *dev);
+
+uint8 SSD1306_dev_getRotation(SSD1306_t *dev);
+
+int16 SSD1306_dev_getCursorX(SSD1306_t *dev);
+int16 SSD1306_dev_getCursorY(SSD1306_t *dev);
+
+extern const uint8 lcd_logo[SSD1306_RAM_MIRROR_SIZE];
+extern const uint8 default_font[];
+
+#ifndef SSD1306_NO_DEFAULT
+// Default instance
+
+SSD1306_t *SSD1306_getDefault(void);
+
 void SSD1306_initialize(void);
 void SSD1306_setAddress(uint8 i2caddr);
 void SSD1306_setVccstate(uint8 vccstate);
@@ -145,11 +611,33 @@ void SSD1306_reset(void);
 
 void SSD1306_begin(void);
 
+void SSD1306_commandBegin(void);
+void SSD1306_command(uint8 c);
+void SSD1306_commandCommit(void);
+
 void SSD1306_displayOff(void);
 void SSD1306_displayOn(void);
 void SSD1306_clearDisplay(void);
 void SSD1306_invertDisplay(uint8 i);
 void SSD1306_display();
+void SSD1306_setFlushChunkSize(uint16 size);
+
+// Double-buffered flush.  With SSD1306_ASYNC_FLUSH, SSD1306_displayAsync()
+// snapshots the frame into the front buffer and returns while a FreeRTOS
+// task sends it, so drawing of the next frame overlaps the bus transfer.
+void SSD1306_displayAsync(void);
+int SSD1306_displayWait(TickType_t ticks);
+void SSD1306_setFlushCallback(void (*callback)(void *arg), void *arg);
+
+void SSD1306_getFlushStats(SSD1306_flushStats_t *stats);
+void SSD1306_resetFlushStats(void);
+
+// Dirty region tracking.  Every write into the draw cache records the
+// touched column span per page, and SSD1306_display() only sends those.
+int SSD1306_isDirty(void);
+int SSD1306_getDirtyRange(uint8 page, uint8 *x0, uint8 *x1);
+void SSD1306_markDirty(void);
+void SSD1306_clearDirty(void);
 
 void SSD1306_startScrollRight(uint8 start, uint8 stop);
 void SSD1306_startScrollLeft(uint8 start, uint8 stop);
@@ -165,9 +653,6 @@ void SSD1306_drawPixel(int16 x, int16 y, uint16 color);
 void SSD1306_drawFastVLine(int16 x, int16 y, int16 h, uint16 color);
 void SSD1306_drawFastHLine(int16 x, int16 y, int16 w, uint16 color);
 
-extern const uint8 lcd_logo[SSD1306_RAM_MIRROR_SIZE];
-extern const uint8 default_font[];
-
 // And now for the parts from the old base class.  Note: these have all been
 // renamed to being SSD1306, but originally were from Adafruit_GFX class
 
@@ -178,6 +663,23 @@ void SSD1306_drawRect(int16 x, int16 y, int16 w, int16 h, uint16 color);
 void SSD1306_fillRect(int16 x, int16 y, int16 w, int16 h, uint16 color);
 void SSD1306_fillScreen(uint16 color);
 
+// Move what is already drawn inside a rectangle by (dx, dy), positive
+// being right and down, and fill the strip left behind with fill (an
+// invalid color leaves it as is).  Returns that strip so only it needs
+// redrawing; for a diagonal move it is the bounding box of both strips.
+SSD1306_rect_t SSD1306_scrollRegion(int16 x, int16 y, int16 w, int16 h,
+      int16 dx, int16 dy, uint16 fill);
+
+// Strip chart over a w x h area (w < 255), keeping its samples in a
+// caller supplied array of w + 1 int16s.  Pass min == max to scale to the
+// samples on show.  Each push scrolls the plot left a column and draws
+// only the new one, unless autoscaling changed the scale, which redraws
+// the whole chart.
+void SSD1306_chartBegin(SSD1306_chart_t *chart, int16 x, int16 y,
+      uint8 w, uint8 h, int16 *samples, int16 min, int16 max, uint16 color, uint16 bg);
+void SSD1306_chartPush(SSD1306_chart_t *chart, int16 value);
+void SSD1306_chartRedraw(SSD1306_chart_t *chart);
+
 void SSD1306_drawCircle(int16 x0, int16 y0, int16 r, uint16 color);
 void SSD1306_drawCircleHelper(int16 x0, int16 y0, int16 r,
       uint8 cornername, uint16 color);
@@ -185,10 +687,24 @@ void SSD1306_drawCircleHelper(int16 x0, int16 y0, int16 r,
 void SSD1306_fillCircle(int16 x0, int16 y0, int16 r, uint16 color);
 void SSD1306_fillCircleHelper(int16 x0, int16 y0, int16 r, uint8 cornername,
       int16 delta, uint16 color);
+// Fill an ellipse with radii rx and ry, each at most 200
+void SSD1306_fillEllipse(int16 x0, int16 y0, int16 rx, int16 ry, uint16 color);
+// Fill the part of a ring, thickness pixels in from radius r, from start
+// to end degrees clockwise from three o'clock.  end may be less than
+// start to wrap past zero; a sweep of 360 or more fills the whole ring.
+void SSD1306_fillArc(int16 x0, int16 y0, int16 r, int16 thickness,
+      int16 start, int16 end, uint16 color);
+// SSD1306_fillArc() with no hole in the middle
+void SSD1306_fillPie(int16 x0, int16 y0, int16 r,
+      int16 start, int16 end, uint16 color);
 void SSD1306_drawTriangle(int16 x0, int16 y0, int16 x1, int16 y1,
       int16 x2, int16 y2, uint16 color);
 void SSD1306_fillTriangle(int16 x0, int16 y0, int16 x1, int16 y1,
       int16 x2, int16 y2, uint16 color);
+// Fill any simple or self-intersecting polygon of up to
+// SSD1306_MAX_POLYGON points, using the even-odd rule.  Three points not
+// all on one row fill exactly what SSD1306_fillTriangle() does.
+void SSD1306_fillPolygon(const SSD1306_point_t *points, uint8 count, uint16 color);
 void SSD1306_drawRoundRect(int16 x0, int16 y0, int16 w, int16 h,
       int16 radius, uint16 color);
 void SSD1306_fillRoundRect(int16 x0, int16 y0, int16 w, int16 h,
@@ -197,7 +713,18 @@ void SSD1306_drawBitmap(int16 x, int16 y, uint8 *bitmap,
       int16 w, int16 h, uint16 color, uint16 bg);
 void SSD1306_drawXBitmap(int16 x, int16 y, const uint8 *bitmap,
       int16 w, int16 h, uint16 color);
-void SSD1306_drawChar(int16 x, int16 y, unsigned char c, uint16 color,
+// Merge an image already in the panel's own layout -- a byte per column
+// for each 8 rows, least significant bit on top, w bytes per 8 rows -- with
+// its top left at x, y using one of the SSD1306_BLIT_* ops.  Only bits set
+// in mask, which has the same layout, are changed; NULL changes them all.
+// The image is placed on the unrotated panel, whatever setRotation() says.
+void SSD1306_blit(int16 x, int16 y, const uint8 *bitmap, const uint8 *mask,
+      int16 w, int16 h, uint8 op);
+// Drop every converted bitmap kept by SSD1306_BITMAP_CACHE
+void SSD1306_forgetBitmaps(void);
+// c is a code point with a GFXfontEx set, so glyphs past U+00FF can be
+// drawn.  The classic font draws nothing above 0xFF.
+void SSD1306_drawChar(int16 x, int16 y, uint16 c, uint16 color,
       uint16 bg, uint8 size);
 void SSD1306_setCursor(int16 x, int16 y);
 void SSD1306_setTextColor(uint16 c, uint16 bg);
@@ -206,10 +733,68 @@ void SSD1306_setTextWrap(int w);
 void SSD1306_setRotation(uint8 r);
 void SSD1306_cp437(int x);
 void SSD1306_setFont(const GFXfont *f);
+// Select a font with 16-bit code points; text is decoded as UTF-8 while
+// it is selected
+void SSD1306_setFontEx(const GFXfontEx *f);
 void SSD1306_getTextBounds(char *string, int16 x, int16 y,
       int16 *x1, int16 *y1, uint16 *w, uint16 *h);
 
-size_t SSD1306_write(uint8);
+// Split a string into the lines SSD1306_write() would produce starting at
+// x, measuring each, in one pass.  Returns the number of lines stored in
+// lines, at most maxLines.
+uint8 SSD1306_layoutText(const char *str, int16 x, SSD1306_textLine_t *lines,
+      uint8 maxLines);
+
+size_t SSD1306_write(uint8 c);
+
+// Lay out and draw len characters from the cursor, as a run of
+// SSD1306_write() calls would, and return the on-screen area drawn.
+SSD1306_rect_t SSD1306_print(const char *str, size_t len);
+SSD1306_rect_t SSD1306_printAt(int16 x, int16 y, const char *str, size_t len);
+
+// Scrolling text console.  Switches to the classic font at size 1 with
+// wrapping on, white on black and rotation 0, and clears the screen.
+// From then on write() and print() wrap at the right edge and scroll by
+// moving the panel's display start line, so a new line sends one page
+// instead of the whole frame.  Font, text size and wrap changes are
+// ignored by the console and only apply after SSD1306_terminalEnd().
+// Other drawing calls address the cache in panel order while it is
+// active.
+void SSD1306_terminalBegin(void);
+void SSD1306_terminalEnd(void);
+
+// Numbers at the cursor without formatting them into a string first,
+// right-aligned in width characters padded with pad (' ' or '0').
+// printFixed() prints value / 10^decimals.  With the classic font and an
+// opaque background, reprinting a field with the same width overwrites
+// the old value in place.
+SSD1306_rect_t SSD1306_printInt(int32 value, uint8 width, char pad);
+SSD1306_rect_t SSD1306_printFixed(int32 value, uint8 decimals, uint8 width, char pad);
+SSD1306_rect_t SSD1306_printHex(uint32 value, uint8 width, char pad);
+
+#if SSD1306_MAX_WIDGETS
+// Retained widgets.  Each add returns an id, or -1 once
+// SSD1306_MAX_WIDGETS are in use.  Labels and values take the font, text
+// size and colors set when they are added; their contents must fit the
+// area given.  A widget repaints its whole area, so its background should
+// be BLACK or WHITE.  Setting a widget only marks it for redrawing if
+// what it shows changed, and SSD1306_updateWidgets() redraws just those
+// (and any widgets they overlap), returning how many it drew.  With
+// nothing changed, an update and SSD1306_display() cost next to nothing.
+int8 SSD1306_addLabel(int16 x, int16 y, int16 w, int16 h, const char *text);
+int8 SSD1306_addValue(int16 x, int16 y, int16 w, int16 h, uint8 decimals);
+int8 SSD1306_addBar(int16 x, int16 y, int16 w, int16 h,
+      uint16 color, uint16 bg, int32 min, int32 max);
+int8 SSD1306_addIcon(int16 x, int16 y, int16 w, int16 h,
+      uint16 color, uint16 bg, const uint8 *bitmap);
+void SSD1306_setWidgetText(int8 id, const char *text);
+void SSD1306_setWidgetValue(int8 id, int32 value);
+void SSD1306_setWidgetBitmap(int8 id, const uint8 *bitmap);
+// Mark the widgets touching an area for redrawing, after drawing over it
+void SSD1306_invalidate(int16 x, int16 y, int16 w, int16 h);
+uint8 SSD1306_updateWidgets(void);
+void SSD1306_clearWidgets(void);
+#endif
 
 int16 SSD1306_height(void);
 int16 SSD1306_width(void);
@@ -219,5 +804,6 @@ uint8 SSD1306_getRotation(void);
 // get current cursor position (get rotation safe maximum values, using: width() for x, height() for y)
 int16 SSD1306_getCursorX(void);
 int16 SSD1306_getCursorY(void);
+#endif // SSD1306_NO_DEFAULT
 
 #endif /* _SSD1306_H_ */
@@ -23,4 +23,20 @@ typedef struct { // Data stored for FONT AS A WHOLE:
 	uint8   yAdvance;    // Newline distance (y axis)
 } GFXfont;
 
+typedef struct { // Run of consecutive code points in a GFXfontEx
+	uint16  first;       // First code point of the run
+	uint16  count;       // Code points in the run
+	uint16  glyph;       // Index of the run's first glyph in font.glyph
+} GFXrange;
+
+// Font with 16-bit code points, carrying only the glyphs it needs.  The
+// glyph array holds the runs back to back, and ranges is sorted by first
+// so a glyph is found by binary search.  font.first and font.last are not
+// used.  Pass to setFontEx(); text is then taken as UTF-8.
+typedef struct {
+	GFXfont  font;       // Bitmaps, glyphs and yAdvance
+	GFXrange *ranges;    // Sorted, non-overlapping runs
+	uint16   rangeCount; // Entries in ranges
+} GFXfontEx;
+
 #endif // _GFXFONT_H_
@@ -14,6 +14,37 @@
 #define __i2cRegister_h__
     
 #include "project.h"
+
+// Staging buffer for interrupt-driven transfers: register byte + data.
+// Longer writes are sent as consecutive transactions of this size.
+#ifndef I2C_TX_BUFFER_SIZE
+#define I2C_TX_BUFFER_SIZE 129
+#endif
+
+// How many ticks a transfer waits for the bus to come free before it is
+// given up as failed
+#ifndef I2C_START_RETRIES
+#define I2C_START_RETRIES 10
+#endif
+
+// Transfer states, from the hardware shim and the async calls below
+#define I2C_XFER_OK     0   // Started, or finished cleanly
+#define I2C_XFER_BUSY   1   // Still running, or the bus can't start one yet
+#define I2C_XFER_ERROR  2   // NAK, lost arbitration or another bus error
+
+// Hardware shim for the interrupt-driven transfer engine.  write_async
+// starts a write of len bytes and returns at once, or says why it
+// couldn't; the transfer completes in the background (I2C interrupt or
+// DMA) and the hardware layer calls i2c_transfer_complete_isr(), as often
+// as it likes.  poll reports the state of the transfer last started.  A
+// simulated bus can stand in for the PSoC one when testing on a host; see
+// test/i2c_sim.c.
+typedef struct {
+    uint8 (*write_async)(uint8 addr, uint8 *buffer, uint16 len);
+    uint8 (*poll)(void);
+} i2c_hw_t;
+
+extern const i2c_hw_t i2c_hw_psoc;
     
 uint8 i2c_register_test_device(uint8 addr);
 uint8 i2c_register_read(uint8 addr, uint8 regnum);
@@ -24,7 +55,24 @@ uint16 i2c_register_read_msb16(uint8 addr, uint8 basereg);
 uint16 i2c_register_read_lsb16(uint8 addr, uint8 basereg);
 uint16 i2c_register_read16be(uint8 addr, uint8 regnum);
 void i2c_register_write16be(uint8 addr, uint8 regnum, uint16 value);
-void i2c_register_write_buffer(uint8 addr, uint8 regnum, uint8 *buffer, uint8 len);
+void i2c_register_write_buffer(uint8 addr, uint8 regnum, uint8 *buffer, uint16 len);
+
+// Streamed writes: one transaction spanning any number of stream_write calls.
+// The bus is held from begin to end, so keep these in the same task.
+void i2c_register_stream_begin(uint8 addr, uint8 regnum);
+void i2c_register_stream_write(uint8 *buffer, uint16 len);
+uint8 i2c_register_stream_end(void);
+
+// Interrupt-driven transfers.  With no hardware shim set (the default)
+// everything above busy-polls the bus a byte at a time.  Once one is set,
+// the stream and async writes queue whole buffers and the calling task
+// sleeps until they complete; i2c_register_stream_end() and
+// i2c_register_wait() return I2C_XFER_ERROR if any part of the transfer
+// failed.  The blocking calls above finish a queued transfer first.
+void i2c_set_hw(const i2c_hw_t *hw);
+void i2c_transfer_complete_isr(void);
+void i2c_register_write_buffer_async(uint8 addr, uint8 regnum, uint8 *buffer, uint16 len);
+uint8 i2c_register_wait(void);
     
 #endif // __i2cRegister_h__
 
@@ -29,259 +29,420 @@ All text above, and the splash screen below must be included in any redistributi
  */
 
 //#include <stdlib.h>
+#include <stdint.h>
 
 #include "project.h"
 #include "SSD1306.h"
 #include "i2cRegisters.h"
 #include "utils.h"
 
-#define draw_pixel(x, y) (cache_pixel(_draw_cache, (x), (y)))
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#define draw_pixel(x, y) (cache_pixel(dev->draw_cache, (x), (y)))
 #define cache_pixel(cache, x, y) ((cache)[SSD1306_PIXEL_ADDR((x), (y))])
+#define _pages(dev) ((dev)->HEIGHT >> 3)
+
+// How a color changes the bits under a mask:
+//   byte = (byte & ~(mask & clr)) ^ (mask & flip)
+// so each drawing loop is the same for every color.
+typedef struct {
+  uint8 clr;
+  uint8 flip;
+} rop_t;
+
+static const rop_t _rops[] = {
+  { 0xFF, 0x00 },   // BLACK
+  { 0xFF, 0xFF },   // WHITE
+  { 0x00, 0xFF },   // INVERSE
+};
+
+// Leaves every bit alone
+static const rop_t _ropNone = { 0x00, 0x00 };
+
+#define _colorRop(color) (((color) < NELEMS(_rops)) ? &_rops[(color)] : NULL)
+
+static void _fillRectInternal(SSD1306_t *dev, int16 x, int16 y, int16 w, int16 h, const rop_t *rop);
+static void _fillRectRotated(SSD1306_t *dev, int16 x, int16 y, int16 w, int16 h, const rop_t *rop);
+static void _drawFontGlyph(SSD1306_t *dev, int16 x, int16 y, uint8 *bitmap,
+                           GFXglyph *glyph, const rop_t *rop, uint8 size);
+static void _terminalWrite(SSD1306_t *dev, uint8 c);
+static void _textRops(uint16 color, uint16 bg, const rop_t **fgrop, const rop_t **bgrop);
+static void _ssd1306_command(SSD1306_t *dev, uint8 c);
+static void _markDirty(SSD1306_t *dev, uint8 page, uint8 x0, uint8 x1);
+static void _sendData(SSD1306_t *dev, uint8 *buffer, uint16 len, uint16 *used);
+static void _sendWindow(SSD1306_t *dev, uint8 *cache, uint8 x0, uint8 x1, uint8 page, uint8 last);
+static int _flushStep(SSD1306_t *dev);
+
+#ifdef SSD1306_ASYNC_FLUSH
+static void _flushTask(void *arg);
+
+// Panels that have used SSD1306_dev_displayAsync(), linked through
+// flush_next, and the task that flushes them
+static SSD1306_t *_flush_list;
+static TaskHandle_t _flush_task;
+#endif
+
+const SSD1306_transport_t SSD1306_i2cTransport = {
+  i2c_register_write_buffer,
+  i2c_register_stream_begin,
+  i2c_register_stream_write,
+  i2c_register_stream_end,
+};
+
+#ifdef SSD1306_ASYNC_FLUSH
+// Whether a panel is on _flush_list already
+static int _flushListed(SSD1306_t *dev) {
+  int listed = 0;
+
+  taskENTER_CRITICAL();
+  for (SSD1306_t *p = _flush_list; p; p = p->flush_next) {
+    if (p == dev) {
+      listed = 1;
+      break;
+    }
+  }
+  taskEXIT_CRITICAL();
+  return listed;
+}
+#endif
+
+void SSD1306_dev_initialize(SSD1306_t *dev) {
+#ifdef SSD1306_ASYNC_FLUSH
+  // Set up the async flush state, but a panel initialized again keeps the
+  // semaphore and flush list link displayAsync() gave it
+  if (!_flushListed(dev)) {
+    dev->flush_idle = NULL;
+    dev->flush_next = NULL;
+    dev->flush_pending = 0;
+  }
+#else
+  dev->flush_idle = NULL;
+#endif
+  dev->flush_callback = NULL;
+  dev->flush_callback_arg = NULL;
+  memset(&dev->stats, 0, sizeof(dev->stats));
+  dev->cmd_len = 0;
+
+  dev->transport = &SSD1306_i2cTransport;
+  dev->WIDTH = SSD1306_LCDWIDTH;
+  dev->HEIGHT = SSD1306_LCDHEIGHT;
+  SSD1306_dev_setRotation(dev, 0);
+  dev->cursor_y  = 0;
+  dev->cursor_x  = 0;
+  dev->textsize  = 1;
+  dev->textcolor = 0xFFFF;
+  dev->textbgcolor = 0xFFFF;
+  dev->wrap      = 1;
+  dev->cp437    = 0;
+  dev->gfxFont   = NULL;
+  dev->gfxFontEx = NULL;
+  dev->utf8_pending = 0;
+  dev->term = 0;
+  dev->start_page = 0;
+  dev->start_shown = 0;
+#if SSD1306_GLYPH_CACHE_SIZE
+  memset(dev->glyph_cache, 0, sizeof(dev->glyph_cache));
+#endif
+#if SSD1306_MEASURE_CACHE_SIZE
+  memset(dev->measure_cache, 0, sizeof(dev->measure_cache));
+  dev->measure_next = 0;
+#endif
+  SSD1306_dev_forgetBitmaps(dev);
+#if SSD1306_MAX_WIDGETS
+  dev->widget_count = 0;
+  dev->widgets_invalid = 0;
+#endif
+  dev->i2caddr = SSD1306_I2C_ADDRESS;
+  dev->vccstate = SSD1306_SWITCHCAPVCC;
+  dev->chunk_size = SSD1306_DEFAULT_CHUNK_SIZE;
+  SSD1306_dev_reset(dev);
+}
+
+void SSD1306_dev_setAddress(SSD1306_t *dev, uint8 i2caddr) {
+  dev->i2caddr = i2caddr;
+}
+
+void SSD1306_dev_setTransport(SSD1306_t *dev, const SSD1306_transport_t *transport) {
+  dev->transport = transport;
+}
+
+// Panel size, for a panel smaller than the one selected in SSD1306.h.
+// Resets the rotation and clears the frame.
+void SSD1306_dev_setGeometry(SSD1306_t *dev, int16 w, int16 h) {
+  dev->WIDTH = min(w, SSD1306_LCDWIDTH);
+  dev->HEIGHT = min(h, SSD1306_LCDHEIGHT) & ~0x07;
+  SSD1306_dev_setRotation(dev, 0);
+  SSD1306_dev_clearDisplay(dev);
+}
+
+// Limit the number of data bytes per I2C transaction during a flush.
+// 0 (the default) streams each address window as one transaction.
+void SSD1306_dev_setFlushChunkSize(SSD1306_t *dev, uint16 size) {
+  dev->chunk_size = size;
+}
+
+void SSD1306_dev_reset(SSD1306_t *dev) {
+  SSD1306_dev_clearDisplay(dev);
+  dev->show_logo = 1;
+}
+
+void SSD1306_dev_displayOff(SSD1306_t *dev)
+{
+  _ssd1306_command(dev, SSD1306_DISPLAYOFF);            // 0xAE
+}
 
-static void _drawFastVLineInternal(int16 x, int16 y, int16 h, uint16 color);
-static void _drawFastHLineInternal(int16 x, int16 y, int16 w, uint16 color);
-static void _ssd1306_command(uint8 c);
-static void _operCache(int16 x, int16 y, oper_t oper_, uint8 mask);
-
-
-static uint8 _i2caddr;
-static int8 _vccstate;
-static uint8 _draw_cache[SSD1306_RAM_MIRROR_SIZE];
-static uint8 _show_logo;
-static int16 _WIDTH;	// Raw display, never changes
-static int16 _HEIGHT;	// Raw display, never changes
-static int16 _width;	// modified by current rotation
-static int16 _height;	// modified by current rotation
-static int16 _cursor_x;
-static int16 _cursor_y;
-static uint16 _textcolor;
-static uint16 _textbgcolor;
-static uint8 _textsize;
-static uint8 _rotation;
-static int _wrap;
-static int _cp437;  // if set, use correct CP437 characterset (default off)
-static GFXfont *_gfxFont;
-
-void SSD1306_initialize(void) {
-  _WIDTH = SSD1306_LCDWIDTH;
-  _HEIGHT = SSD1306_LCDHEIGHT;
-  _width    = _WIDTH;
-  _height   = _HEIGHT;
-  _rotation  = 0;
-  _cursor_y  = 0;
-  _cursor_x  = 0;
-  _textsize  = 1;
-  _textcolor = 0xFFFF;
-  _textbgcolor = 0xFFFF;
-  _wrap      = 1;
-  _cp437    = 0;
-  _gfxFont   = NULL;
-  _i2caddr = SSD1306_I2C_ADDRESS;
-  _vccstate = SSD1306_SWITCHCAPVCC;
-  SSD1306_reset();
-}
-
-void SSD1306_setAddress(uint8 i2caddr) {
-  _i2caddr = i2caddr;
-}
-
-void SSD1306_reset(void) {
-  SSD1306_clearDisplay();
-  _show_logo = 1;
-}
-
-void SSD1306_displayOff(void)
+void SSD1306_dev_displayOn(SSD1306_t *dev)
 {
-  _ssd1306_command(SSD1306_DISPLAYOFF);            // 0xAE
+  _ssd1306_command(dev, SSD1306_DISPLAYON);             //--turn on oled panel
 }
 
-void SSD1306_displayOn(void)
+static void _markDirty(SSD1306_t *dev, uint8 page, uint8 x0, uint8 x1)
 {
-  _ssd1306_command(SSD1306_DISPLAYON);             //--turn on oled panel
+    if (x0 < dev->dirty_x0[page]) {
+        dev->dirty_x0[page] = x0;
+    }
+    if (x1 > dev->dirty_x1[page]) {
+        dev->dirty_x1[page] = x1;
+    }
 }
 
-static void _operCache(int16 x, int16 y, oper_t oper_, uint8 mask)
+int SSD1306_dev_isDirty(SSD1306_t *dev)
 {
-    uint8 *addr = &draw_pixel(x, y);
-    uint8_t data = *addr;
+    for (uint8 page = 0; page < _pages(dev); page++) {
+        if (dev->dirty_x0[page] <= dev->dirty_x1[page]) {
+            return 1;
+        }
+    }
+    return 0;
+}
 
-    switch (oper_) {
-        case SET_BITS:
-            data |= mask;
-            break;
-        case CLEAR_BITS:
-            data &= ~mask;
-            break;
-        case TOGGLE_BITS:
-            data ^= mask;
-            break;
-        default:
-            break;
+// Returns non-zero and the inclusive column span if the page is dirty
+int SSD1306_dev_getDirtyRange(SSD1306_t *dev, uint8 page, uint8 *x0, uint8 *x1)
+{
+    if (page >= _pages(dev) || dev->dirty_x0[page] > dev->dirty_x1[page]) {
+        return 0;
     }
 
-    *addr = data;
+    *x0 = dev->dirty_x0[page];
+    *x1 = dev->dirty_x1[page];
+    return 1;
+}
+
+// Force the next SSD1306_dev_display() to send the whole frame
+void SSD1306_dev_markDirty(SSD1306_t *dev)
+{
+    SSD1306_dev_clearDirty(dev);
+    memset(dev->dirty_x0, 0, _pages(dev));
+    memset(dev->dirty_x1, dev->WIDTH - 1, _pages(dev));
+}
+
+void SSD1306_dev_clearDirty(SSD1306_t *dev)
+{
+    memset(dev->dirty_x0, 0xFF, SSD1306_PAGES);
+    memset(dev->dirty_x1, 0, SSD1306_PAGES);
 }
 
-void SSD1306_setVccstate(uint8 vccstate) {
-  _vccstate = vccstate;
+void SSD1306_dev_setVccstate(SSD1306_t *dev, uint8 vccstate) {
+  dev->vccstate = vccstate;
 }
 
-void SSD1306_begin(void) {
+void SSD1306_dev_begin(SSD1306_t *dev) {
+#ifdef SSD1306_SHADOW_DIFF
+  dev->shadow_valid = 0;
+#endif
+  dev->start_shown = 0;
+
   // Init sequence
-  _ssd1306_command(SSD1306_DISPLAYOFF);            // 0xAE
-  _ssd1306_command(SSD1306_SETDISPLAYCLOCKDIV);    // 0xD5
-  _ssd1306_command(0x80);                          // the suggested ratio 0x80
-
-  _ssd1306_command(SSD1306_SETMULTIPLEX);          // 0xA8
-  _ssd1306_command(SSD1306_LCDHEIGHT - 1);
-
-  _ssd1306_command(SSD1306_SETDISPLAYOFFSET);      // 0xD3
-  _ssd1306_command(0x0);                           // no offset
-  _ssd1306_command(SSD1306_SETSTARTLINE | 0x0);    // line #0
-  _ssd1306_command(SSD1306_CHARGEPUMP);            // 0x8D
-  if (_vccstate == SSD1306_EXTERNALVCC) {
-    _ssd1306_command(0x10);
-  } else {
-    _ssd1306_command(0x14);
-  }
-  _ssd1306_command(SSD1306_MEMORYMODE);            // 0x20
-  _ssd1306_command(0x00);                          // 0x0 act like ks0108
-  _ssd1306_command(SSD1306_SEGREMAP | 0x1);
-  _ssd1306_command(SSD1306_COMSCANDEC);
-
-#if defined SSD1306_128_32
-  _ssd1306_command(SSD1306_SETCOMPINS);            // 0xDA
-  _ssd1306_command(0x02);
-  _ssd1306_command(SSD1306_SETCONTRAST);           // 0x81
-  _ssd1306_command(0x8F);
-#elif defined SSD1306_128_64
-  _ssd1306_command(SSD1306_SETCOMPINS);            // 0xDA
-  _ssd1306_command(0x12);
-  _ssd1306_command(SSD1306_SETCONTRAST);           // 0x81
-  if (_vccstate == SSD1306_EXTERNALVCC) {
-    _ssd1306_command(0x9F);
-  } else {
-    _ssd1306_command(0xCF);
-  }
-#elif defined SSD1306_96_16
-  _ssd1306_command(SSD1306_SETCOMPINS);            // 0xDA
-  _ssd1306_command(0x2);   //ada x12
-  _ssd1306_command(SSD1306_SETCONTRAST);           // 0x81
-  if (vccstate == SSD1306_EXTERNALVCC) {
-    _ssd1306_command(0x10);
+  SSD1306_dev_commandBegin(dev);
+  SSD1306_dev_command(dev, SSD1306_DISPLAYOFF);           // 0xAE
+  SSD1306_dev_command(dev, SSD1306_SETDISPLAYCLOCKDIV);   // 0xD5
+  SSD1306_dev_command(dev, 0x80);                         // the suggested ratio 0x80
+
+  SSD1306_dev_command(dev, SSD1306_SETMULTIPLEX);         // 0xA8
+  SSD1306_dev_command(dev, dev->HEIGHT - 1);
+
+  SSD1306_dev_command(dev, SSD1306_SETDISPLAYOFFSET);     // 0xD3
+  SSD1306_dev_command(dev, 0x0);                          // no offset
+  SSD1306_dev_command(dev, SSD1306_SETSTARTLINE | 0x0);   // line #0
+  SSD1306_dev_command(dev, SSD1306_CHARGEPUMP);           // 0x8D
+  if (dev->vccstate == SSD1306_EXTERNALVCC) {
+    SSD1306_dev_command(dev, 0x10);
   } else {
-    _ssd1306_command(0xAF);
-#endif
+    SSD1306_dev_command(dev, 0x14);
+  }
+  SSD1306_dev_command(dev, SSD1306_MEMORYMODE);           // 0x20
+  SSD1306_dev_command(dev, 0x00);                         // 0x0 act like ks0108
+  SSD1306_dev_command(dev, SSD1306_SEGREMAP | 0x1);
+  SSD1306_dev_command(dev, SSD1306_COMSCANDEC);
+
+  if (dev->HEIGHT == 32) {
+    SSD1306_dev_command(dev, SSD1306_SETCOMPINS);         // 0xDA
+    SSD1306_dev_command(dev, 0x02);
+    SSD1306_dev_command(dev, SSD1306_SETCONTRAST);        // 0x81
+    SSD1306_dev_command(dev, 0x8F);
+  } else if (dev->HEIGHT == 64) {
+    SSD1306_dev_command(dev, SSD1306_SETCOMPINS);         // 0xDA
+    SSD1306_dev_command(dev, 0x12);
+    SSD1306_dev_command(dev, SSD1306_SETCONTRAST);        // 0x81
+    if (dev->vccstate == SSD1306_EXTERNALVCC) {
+      SSD1306_dev_command(dev, 0x9F);
+    } else {
+      SSD1306_dev_command(dev, 0xCF);
+    }
+  } else if (dev->HEIGHT == 16) {
+    SSD1306_dev_command(dev, SSD1306_SETCOMPINS);         // 0xDA
+    SSD1306_dev_command(dev, 0x2);                        //ada x12
+    SSD1306_dev_command(dev, SSD1306_SETCONTRAST);        // 0x81
+    if (dev->vccstate == SSD1306_EXTERNALVCC) {
+      SSD1306_dev_command(dev, 0x10);
+    } else {
+      SSD1306_dev_command(dev, 0xAF);
+    }
+  }
 
-  _ssd1306_command(SSD1306_SETPRECHARGE);          // 0xd9
-  if (_vccstate == SSD1306_EXTERNALVCC) {
-    _ssd1306_command(0x22);
+  SSD1306_dev_command(dev, SSD1306_SETPRECHARGE);         // 0xd9
+  if (dev->vccstate == SSD1306_EXTERNALVCC) {
+    SSD1306_dev_command(dev, 0x22);
   } else {
-    _ssd1306_command(0xF1);
+    SSD1306_dev_command(dev, 0xF1);
   }
-  _ssd1306_command(SSD1306_SETVCOMDETECT);         // 0xDB
-  _ssd1306_command(0x40);
-  _ssd1306_command(SSD1306_DISPLAYALLON_RESUME);   // 0xA4
-  _ssd1306_command(SSD1306_NORMALDISPLAY);         // 0xA6
+  SSD1306_dev_command(dev, SSD1306_SETVCOMDETECT);        // 0xDB
+  SSD1306_dev_command(dev, 0x40);
+  SSD1306_dev_command(dev, SSD1306_DISPLAYALLON_RESUME);  // 0xA4
+  SSD1306_dev_command(dev, SSD1306_NORMALDISPLAY);        // 0xA6
 
-  _ssd1306_command(SSD1306_DEACTIVATE_SCROLL);
+  SSD1306_dev_command(dev, SSD1306_DEACTIVATE_SCROLL);
 
-  _ssd1306_command(SSD1306_DISPLAYON);             //--turn on oled panel
+  SSD1306_dev_command(dev, SSD1306_DISPLAYON);            //--turn on oled panel
+  SSD1306_dev_commandCommit(dev);
 }
 
 
-void SSD1306_invertDisplay(uint8 i) {
+void SSD1306_dev_invertDisplay(SSD1306_t *dev, uint8 i) {
   if (i) {
-    _ssd1306_command(SSD1306_INVERTDISPLAY);
+    _ssd1306_command(dev, SSD1306_INVERTDISPLAY);
   } else {
-    _ssd1306_command(SSD1306_NORMALDISPLAY);
+    _ssd1306_command(dev, SSD1306_NORMALDISPLAY);
   }
 }
 
-static void _ssd1306_command(uint8 c) {
+static void _ssd1306_command(SSD1306_t *dev, uint8 c) {
   // I2C
   uint8 control = 0x00;   // Co = 0, D/C = 0
-  i2c_register_write(_i2caddr, control, c);
+  dev->transport->write_buffer(dev->i2caddr, control, &c, 1);
+}
+
+// Command stream.  Bytes queued with SSD1306_dev_command() go out together
+// in a single control 0x00 transaction on SSD1306_dev_commandCommit().  A
+// full buffer is committed early, which the controller accepts even in the
+// middle of a multi-byte command.
+void SSD1306_dev_commandBegin(SSD1306_t *dev) {
+  dev->cmd_len = 0;
+}
+
+void SSD1306_dev_command(SSD1306_t *dev, uint8 c) {
+  if (dev->cmd_len >= SSD1306_CMD_BUFFER_SIZE) {
+    SSD1306_dev_commandCommit(dev);
+  }
+  dev->cmd_buf[dev->cmd_len++] = c;
+}
+
+void SSD1306_dev_commandCommit(SSD1306_t *dev) {
+  if (dev->cmd_len) {
+    // Co = 0, D/C = 0
+    dev->transport->write_buffer(dev->i2caddr, 0x00, dev->cmd_buf, dev->cmd_len);
+    dev->cmd_len = 0;
+  }
 }
 
 // startScrolLright
 // Activate a right handed scroll for rows start through stop
 // Hint, the display is 16 rows tall. To scroll the whole display, run:
 // display.scrollright(0x00, 0x0F)
-void SSD1306_startScrollRight(uint8 start, uint8 stop){
-  _ssd1306_command(SSD1306_RIGHT_HORIZONTAL_SCROLL);
-  _ssd1306_command(0x00);
-  _ssd1306_command(start);
-  _ssd1306_command(0x00);
-  _ssd1306_command(stop);
-  _ssd1306_command(0x00);
-  _ssd1306_command(0xFF);
-  _ssd1306_command(SSD1306_ACTIVATE_SCROLL);
+void SSD1306_dev_startScrollRight(SSD1306_t *dev, uint8 start, uint8 stop){
+  SSD1306_dev_commandBegin(dev);
+  SSD1306_dev_command(dev, SSD1306_RIGHT_HORIZONTAL_SCROLL);
+  SSD1306_dev_command(dev, 0x00);
+  SSD1306_dev_command(dev, start);
+  SSD1306_dev_command(dev, 0x00);
+  SSD1306_dev_command(dev, stop);
+  SSD1306_dev_command(dev, 0x00);
+  SSD1306_dev_command(dev, 0xFF);
+  SSD1306_dev_command(dev, SSD1306_ACTIVATE_SCROLL);
+  SSD1306_dev_commandCommit(dev);
 }
 
 // startScrollLeft
 // Activate a right handed scroll for rows start through stop
 // Hint, the display is 16 rows tall. To scroll the whole display, run:
 // display.scrollright(0x00, 0x0F)
-void SSD1306_startScrollLeft(uint8 start, uint8 stop){
-  _ssd1306_command(SSD1306_LEFT_HORIZONTAL_SCROLL);
-  _ssd1306_command(0x00);
-  _ssd1306_command(start);
-  _ssd1306_command(0x00);
-  _ssd1306_command(stop);
-  _ssd1306_command(0x00);
-  _ssd1306_command(0xFF);
-  _ssd1306_command(SSD1306_ACTIVATE_SCROLL);
+void SSD1306_dev_startScrollLeft(SSD1306_t *dev, uint8 start, uint8 stop){
+  SSD1306_dev_commandBegin(dev);
+  SSD1306_dev_command(dev, SSD1306_LEFT_HORIZONTAL_SCROLL);
+  SSD1306_dev_command(dev, 0x00);
+  SSD1306_dev_command(dev, start);
+  SSD1306_dev_command(dev, 0x00);
+  SSD1306_dev_command(dev, stop);
+  SSD1306_dev_command(dev, 0x00);
+  SSD1306_dev_command(dev, 0xFF);
+  SSD1306_dev_command(dev, SSD1306_ACTIVATE_SCROLL);
+  SSD1306_dev_commandCommit(dev);
 }
 
 // startScrollDiagRight
 // Activate a diagonal scroll for rows start through stop
 // Hint, the display is 16 rows tall. To scroll the whole display, run:
 // display.scrollright(0x00, 0x0F)
-void SSD1306_startScrollDiagRight(uint8 start, uint8 stop){
-  _ssd1306_command(SSD1306_SET_VERTICAL_SCROLL_AREA);
-  _ssd1306_command(0x00);
-  _ssd1306_command(SSD1306_LCDHEIGHT);
-  _ssd1306_command(SSD1306_VERTICAL_AND_RIGHT_HORIZONTAL_SCROLL);
-  _ssd1306_command(0x00);
-  _ssd1306_command(start);
-  _ssd1306_command(0x00);
-  _ssd1306_command(stop);
-  _ssd1306_command(0x01);
-  _ssd1306_command(SSD1306_ACTIVATE_SCROLL);
+void SSD1306_dev_startScrollDiagRight(SSD1306_t *dev, uint8 start, uint8 stop){
+  SSD1306_dev_commandBegin(dev);
+  SSD1306_dev_command(dev, SSD1306_SET_VERTICAL_SCROLL_AREA);
+  SSD1306_dev_command(dev, 0x00);
+  SSD1306_dev_command(dev, dev->HEIGHT);
+  SSD1306_dev_command(dev, SSD1306_VERTICAL_AND_RIGHT_HORIZONTAL_SCROLL);
+  SSD1306_dev_command(dev, 0x00);
+  SSD1306_dev_command(dev, start);
+  SSD1306_dev_command(dev, 0x00);
+  SSD1306_dev_command(dev, stop);
+  SSD1306_dev_command(dev, 0x01);
+  SSD1306_dev_command(dev, SSD1306_ACTIVATE_SCROLL);
+  SSD1306_dev_commandCommit(dev);
 }
 
 // startScrollDiagLeft
 // Activate a diagonal scroll for rows start through stop
 // Hint, the display is 16 rows tall. To scroll the whole display, run:
 // display.scrollright(0x00, 0x0F)
-void SSD1306_startScrollDiagLeft(uint8 start, uint8 stop){
-  _ssd1306_command(SSD1306_SET_VERTICAL_SCROLL_AREA);
-  _ssd1306_command(0x00);
-  _ssd1306_command(SSD1306_LCDHEIGHT);
-  _ssd1306_command(SSD1306_VERTICAL_AND_LEFT_HORIZONTAL_SCROLL);
-  _ssd1306_command(0x00);
-  _ssd1306_command(start);
-  _ssd1306_command(0x00);
-  _ssd1306_command(stop);
-  _ssd1306_command(0x01);
-  _ssd1306_command(SSD1306_ACTIVATE_SCROLL);
+void SSD1306_dev_startScrollDiagLeft(SSD1306_t *dev, uint8 start, uint8 stop){
+  SSD1306_dev_commandBegin(dev);
+  SSD1306_dev_command(dev, SSD1306_SET_VERTICAL_SCROLL_AREA);
+  SSD1306_dev_command(dev, 0x00);
+  SSD1306_dev_command(dev, dev->HEIGHT);
+  SSD1306_dev_command(dev, SSD1306_VERTICAL_AND_LEFT_HORIZONTAL_SCROLL);
+  SSD1306_dev_command(dev, 0x00);
+  SSD1306_dev_command(dev, start);
+  SSD1306_dev_command(dev, 0x00);
+  SSD1306_dev_command(dev, stop);
+  SSD1306_dev_command(dev, 0x01);
+  SSD1306_dev_command(dev, SSD1306_ACTIVATE_SCROLL);
+  SSD1306_dev_commandCommit(dev);
 }
 
-void SSD1306_stopScroll(void){
-  _ssd1306_command(SSD1306_DEACTIVATE_SCROLL);
+void SSD1306_dev_stopScroll(SSD1306_t *dev){
+  _ssd1306_command(dev, SSD1306_DEACTIVATE_SCROLL);
 }
 
 // Dim the display
 // dim = true: display is dimmed
 // dim = false: display is normal
-void SSD1306_dim(int dim) {
+void SSD1306_dev_dim(SSD1306_t *dev, int dim) {
   uint8 contrast;
 
   if (dim) {
     contrast = 0; // Dimmed display
   } else {
-    if (_vccstate == SSD1306_EXTERNALVCC) {
+    if (dev->vccstate == SSD1306_EXTERNALVCC) {
       contrast = 0x9F;
     } else {
       contrast = 0xCF;
@@ -289,527 +450,1846 @@ void SSD1306_dim(int dim) {
   }
   // the range of contrast to too small to be really useful
   // it is useful to dim the display
-  _ssd1306_command(SSD1306_SETCONTRAST);
-  _ssd1306_command(contrast);
+  SSD1306_dev_commandBegin(dev);
+  SSD1306_dev_command(dev, SSD1306_SETCONTRAST);
+  SSD1306_dev_command(dev, contrast);
+  SSD1306_dev_commandCommit(dev);
 }
 
-void SSD1306_display(void) {
-  _ssd1306_command(SSD1306_COLUMNADDR);
-  _ssd1306_command(0);                  // Column start address (0 = reset)
-  _ssd1306_command(SSD1306_LCDWIDTH-1); // Column end address (127 = reset)
+// Send one address window covering columns x0..x1 of pages page..last
+static void _sendWindow(SSD1306_t *dev, uint8 *cache, uint8 x0, uint8 x1, uint8 page, uint8 last) {
+  const SSD1306_transport_t *t = dev->transport;
+  uint8 window[6] = {
+    SSD1306_COLUMNADDR, x0, x1,           // Column start/end address
+    SSD1306_PAGEADDR, page, last,         // Page start/end address
+  };
+  t->write_buffer(dev->i2caddr, 0x00, window, sizeof(window));
+
+  uint16 used = 0;
+  t->stream_begin(dev->i2caddr, 0x40);    // Co = 0, D/C = 1
+  for (; page <= last; page++) {
+    uint16 offset = SSD1306_PIXEL_ADDR(x0, page << 3);
+    _sendData(dev, &cache[offset], x1 - x0 + 1, &used);
+#ifdef SSD1306_SHADOW_DIFF
+    memcpy(&dev->shadow[offset], &cache[offset], x1 - x0 + 1);
+#endif
+    dev->stats.sent_bytes += x1 - x0 + 1;
+  }
+  if (t->stream_end() != I2C_XFER_OK) {
+    dev->stats.errors++;
+  }
+  dev->stats.windows++;
+}
 
-  _ssd1306_command(SSD1306_PAGEADDR);
-  _ssd1306_command(0);                  // Page start address (0 = reset)
-  _ssd1306_command((SSD1306_LCDHEIGHT >> 3) - 1); // Page end address
+// Stream data bytes into the open data transaction, restarting it every
+// chunk_size bytes.  GDDRAM addressing carries on across the restart.
+static void _sendData(SSD1306_t *dev, uint8 *buffer, uint16 len, uint16 *used) {
+  const SSD1306_transport_t *t = dev->transport;
 
-  uint8 *cache = (_show_logo ? (uint8 *)lcd_logo : _draw_cache);
+  while (len) {
+    uint16 count = len;
 
-  for (int16 y = 0; y < SSD1306_LCDHEIGHT; y += 8) {
-    for (uint8 x = 0; x < SSD1306_LCDWIDTH; x += 16) {
-      // Co = 0, D/C = 1
-      i2c_register_write_buffer(_i2caddr, 0x40, &cache_pixel(cache, x, y), 16);
+    if (dev->chunk_size) {
+      if (*used >= dev->chunk_size) {
+        if (t->stream_end() != I2C_XFER_OK) {
+          dev->stats.errors++;
+        }
+        t->stream_begin(dev->i2caddr, 0x40);
+        *used = 0;
+      }
+      count = min(len, dev->chunk_size - *used);
     }
-  }
 
-  if (_show_logo) {
-    SSD1306_clearDisplay();
+    t->stream_write(buffer, count);
+    buffer += count;
+    len -= count;
+    *used += count;
   }
 }
 
-// clear everything
-void SSD1306_clearDisplay(void) {
-  _show_logo = 0;
-  memset(_draw_cache, 0, SSD1306_RAM_MIRROR_SIZE);
-}
+#ifdef SSD1306_SHADOW_DIFF
+// Send only the bytes of a dirty span that differ from what the panel
+// already holds.  Two runs of changed bytes are merged when resending the
+// unchanged gap between them is cheaper than opening another window.
+static void _flushPageDiff(SSD1306_t *dev, uint8 *cache, uint8 page, uint8 x0, uint8 x1) {
+  uint8 *src = &cache_pixel(cache, 0, page << 3);
+  uint8 *shadow = &cache_pixel(dev->shadow, 0, page << 3);
+  int16 x = x0;
+
+  while (x <= x1) {
+    if (src[x] == shadow[x]) {
+      x++;
+      continue;
+    }
 
-// the most basic function, set a single pixel
-void SSD1306_drawPixel(int16 x, int16 y, uint16 color) {
-  if ((x < 0) || (x >= _width) || (y < 0) || (y >= _height))
-    return;
+    int16 start = x;
+    int16 end = x;
+    for (x++; x <= x1 && (x - end - 1) <= SSD1306_WINDOW_COST; x++) {
+      if (src[x] != shadow[x]) {
+        end = x;
+      }
+    }
 
-  // check rotation, move pixel around if necessary
-  switch (_rotation) {
-  case 1:
-    _swap_int16(x, y);
-    x = _WIDTH - x - 1;
-    break;
-  case 2:
-    x = _WIDTH - x - 1;
-    y = _HEIGHT - y - 1;
-    break;
-  case 3:
-    _swap_int16(x, y);
-    y = _HEIGHT - y - 1;
-    break;
+    _sendWindow(dev, cache, start, end, page, page);
   }
+}
+#endif
 
-  // x is which column
-  uint8 mask = (1 << (y & 0x07));
-  
-  switch (color)
-  {
-    case WHITE:   
-      _operCache(x, y, SET_BITS, mask);  
-      break;
-    case BLACK:   
-      _operCache(x, y, CLEAR_BITS, mask);  
-      break;
-    case INVERSE: 
-      _operCache(x, y, TOGGLE_BITS, mask);  
-      break;
-    default:
-      return;
+// Start flushing a frame from cache, sending the spans in dirty_x0/x1
+static void _flushBegin(SSD1306_t *dev, uint8 *cache, uint8 *dirty_x0, uint8 *dirty_x1) {
+  dev->flush_cache = cache;
+  dev->flush_x0 = dirty_x0;
+  dev->flush_x1 = dirty_x1;
+  dev->flush_page = 0;
+  dev->flush_start = 0xFF;
+  if (dev->start_page != dev->start_shown) {
+    dev->flush_start = dev->start_page;
+    dev->start_shown = dev->start_page;
   }
+  dev->stats.dirty_bytes = 0;
+  dev->stats.sent_bytes = 0;
+  dev->stats.windows = 0;
+  dev->stats.errors = 0;
 }
 
-
-void SSD1306_drawFastHLine(int16 x, int16 y, int16 w, uint16 color) {
-  int bSwap = 0;
-  switch(_rotation) {
-    case 0:
-      // 0 degree rotation, do nothing
-      break;
-    case 1:
-      // 90 degree rotation, swap x & y for rotation, then invert x
-      bSwap = 1;
-      _swap_int16(x, y);
-      x = _WIDTH - x - 1;
-      break;
-    case 2:
-      // 180 degree rotation, invert x and y - then shift y around for height.
-      x = _WIDTH - x - 1;
-      y = _HEIGHT - y - 1;
-      x -= (w-1);
-      break;
-    case 3:
-      // 270 degree rotation, swap x & y for rotation, then invert y  and adjust y for w (not to become h)
-      bSwap = 1;
-      _swap_int16(x, y);
-      y = _HEIGHT - y - 1;
-      y -= (w-1);
-      break;
+// Send the next window of the frame being flushed (with shadow diffing,
+// the next page).  Returns 0 once the frame is complete.  The window
+// preamble is built locally rather than in the command stream, as this
+// also runs from the flush task.
+static int _flushStep(SSD1306_t *dev) {
+  uint8 *dirty_x0 = dev->flush_x0;
+  uint8 *dirty_x1 = dev->flush_x1;
+  uint8 pages = _pages(dev);
+  uint8 page = dev->flush_page;
+
+  while (page < pages && dirty_x0[page] > dirty_x1[page]) {
+    page++;
   }
 
-  if(bSwap) {
-    _drawFastVLineInternal(x, y, w, color);
-  } else {
-    _drawFastHLineInternal(x, y, w, color);
-  }
-}
+  if (page >= pages) {
+#ifdef SSD1306_SHADOW_DIFF
+    // A failed window leaves the panel out of step with the shadow, so
+    // the next flush sends everything
+    dev->shadow_valid = !dev->stats.errors;
+#endif
+    dev->stats.total_saved += dev->stats.dirty_bytes - dev->stats.sent_bytes;
+    dev->flush_page = page;
 
-static void _drawFastHLineInternal(int16 x, int16 y, int16 w, uint16 color) {
-  // Do bounds/limit checks
-  if (y < 0 || y >= _HEIGHT) {
-    return;
+    // Move the display start once the rows it exposes have been sent
+    if (dev->flush_start != 0xFF) {
+      _ssd1306_command(dev, SSD1306_SETSTARTLINE | (dev->flush_start << 3));
+      dev->flush_start = 0xFF;
+    }
+    return 0;
   }
 
-  // make sure we don't try to draw below 0
-  if (x < 0) {
-    w += x;
-    x = 0;
+  uint8 x0 = dirty_x0[page];
+  uint8 x1 = dirty_x1[page];
+  uint8 last = page;
+
+  dev->stats.dirty_bytes += x1 - x0 + 1;
+
+#ifdef SSD1306_SHADOW_DIFF
+  if (dev->shadow_valid) {
+    _flushPageDiff(dev, dev->flush_cache, page, x0, x1);
+    dev->flush_page = page + 1;
+    return 1;
   }
+#endif
 
-  // make sure we don't go off the edge of the display
-  if ((x + w) > _WIDTH) {
-    w = (_WIDTH - x);
+  // Pages with the same span share one address window
+  while (last + 1 < pages && dirty_x0[last + 1] == x0 &&
+         dirty_x1[last + 1] == x1) {
+    last++;
+    dev->stats.dirty_bytes += x1 - x0 + 1;
   }
 
-  // if our width is now negative, punt
-  if (w <= 0) {
+  _sendWindow(dev, dev->flush_cache, x0, x1, page, last);
+  dev->flush_page = last + 1;
+  return 1;
+}
+
+// The semaphore held while a frame is being sent, made on first use
+static void _flushIdleCreate(SSD1306_t *dev) {
+  SemaphoreHandle_t sem;
+
+  if (dev->flush_idle) {
     return;
   }
 
-  register uint8 mask = SSD1306_PIXEL_MASK(y);
-  for (uint8 i = x; i < x + w; i++) {
-    switch (color)
-    {
-      case WHITE:
-        _operCache(i, y, SET_BITS, mask);
-        break;
-      case BLACK:
-        _operCache(i, y, CLEAR_BITS, mask);
-        break;
-      case INVERSE:
-        _operCache(i, y, TOGGLE_BITS, mask);
-        break;
-      default:
-        return;
-    }
-  }
-}
+  sem = xSemaphoreCreateBinary();
+  xSemaphoreGive(sem);
 
-void SSD1306_drawFastVLine(int16 x, int16 y, int16 h, uint16 color) {
-  int bSwap = 0;
-  switch(_rotation) {
-    case 0:
-      break;
-    case 1:
-      // 90 degree rotation, swap x & y for rotation, then invert x and adjust x for h (now to become w)
-      bSwap = 1;
-      _swap_int16(x, y);
-      x = _WIDTH - x - 1;
-      x -= (h-1);
-      break;
-    case 2:
-      // 180 degree rotation, invert x and y - then shift y around for height.
-      x = _WIDTH - x - 1;
-      y = _HEIGHT - y - 1;
-      y -= (h-1);
-      break;
-    case 3:
-      // 270 degree rotation, swap x & y for rotation, then invert y
-      bSwap = 1;
-      _swap_int16(x, y);
-      y = _HEIGHT - y - 1;
-      break;
+  taskENTER_CRITICAL();
+  if (!dev->flush_idle) {
+    dev->flush_idle = sem;
+    sem = NULL;
   }
+  taskEXIT_CRITICAL();
 
-  if(bSwap) {
-    _drawFastHLineInternal(x, y, h, color);
-  } else {
-    _drawFastVLineInternal(x, y, h, color);
+  // Another task got there first
+  if (sem) {
+    vSemaphoreDelete(sem);
   }
 }
 
+void SSD1306_dev_display(SSD1306_t *dev) {
+  uint8 *cache;
 
-static void _drawFastVLineInternal(int16 x, int16 __y, int16 __h, uint16 color) {
+  // Don't interleave our windows with a frame still in flight, or let one
+  // start until ours has been sent
+  _flushIdleCreate(dev);
+  xSemaphoreTake(dev->flush_idle, portMAX_DELAY);
 
-  // do nothing if we're off the left or right side of the screen
-  if (x < 0 || x >= _WIDTH) {
-    return;
+#ifdef SSD1306_SHADOW_DIFF
+  if (!dev->shadow_valid) {
+    SSD1306_dev_markDirty(dev);
   }
+#endif
 
-  // make sure we don't try to draw below 0
-  if (__y < 0) {
-    // __y is negative, this will subtract enough from __h to account for __y being 0
-    __h += __y;
-    __y = 0;
+  if (dev->show_logo) {
+    cache = (uint8 *)lcd_logo;
+    SSD1306_dev_markDirty(dev);
+  } else {
+    cache = dev->draw_cache;
   }
 
-  // make sure we don't go past the height of the display
-  if ((__y + __h) > _HEIGHT) {
-    __h = (_HEIGHT - __y);
+  _flushBegin(dev, cache, dev->dirty_x0, dev->dirty_x1);
+  while (_flushStep(dev)) {
   }
+  SSD1306_dev_clearDirty(dev);
 
-  // if our height is now negative, punt
-  if (__h <= 0) {
-    return;
+  if (dev->show_logo) {
+    SSD1306_dev_clearDisplay(dev);
   }
 
-  // this display doesn't need ints for coordinates, use local byte registers
-  // for faster juggling
-  register uint8 y = __y;
-  register uint8 h = __h;
+  xSemaphoreGive(dev->flush_idle);
+}
 
-  // do the first partial byte, if necessary - this requires some masking
-  register uint8 mod = (y & 0x07);
-  register uint8 data;
-  if (mod) {
-    // mask off the high n bits we want to set
-    mod = 8 - mod;
+#ifdef SSD1306_ASYNC_FLUSH
+// One task flushes the frames of every panel.  Each pass sends one window
+// for each panel with a frame pending, so panels sharing a bus interleave
+// rather than queue up behind each other.
+static void _flushTask(void *arg) {
+  (void)arg;
 
-    // note - lookup table results in a nearly 10% performance improvement in
-    // fill* functions
-    // register uint8 mask = ~(0xFF >> (mod));
-    static uint8 premask[8] = {0x00, 0x80, 0xC0, 0xE0, 0xF0, 0xF8, 0xFC, 0xFE };
-    register uint8 mask = premask[mod];
+  for (;;) {
+    int busy;
 
-    // adjust the mask if we're not going to reach the end of this byte
-    if (h < mod) {
-      mask &= (0xFF >> (mod-h));
-    }
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 
-    switch (color)
-    {
-      case WHITE:
-        _operCache(x, y, SET_BITS, mask);
-        break;
-      case BLACK:
-        _operCache(x, y, CLEAR_BITS, mask);
-        break;
-      case INVERSE:
-        _operCache(x, y, TOGGLE_BITS, mask);
-        break;
-      default:
-        return;
-    }
+    do {
+      busy = 0;
+      for (SSD1306_t *dev = _flush_list; dev; dev = dev->flush_next) {
+        if (!dev->flush_pending) {
+          continue;
+        }
 
-    // fast exit if we're done here!
-    if (h < mod) {
-      return;
-    }
+        if (_flushStep(dev)) {
+          busy = 1;
+          continue;
+        }
 
-    h -= mod;
-    y += mod;
+        // Release the front buffer before the callback, which may well
+        // queue the next frame
+        void (*callback)(void *) = dev->flush_callback;
+        void *callback_arg = dev->flush_callback_arg;
+        dev->flush_pending = 0;
+        xSemaphoreGive(dev->flush_idle);
+        if (callback) {
+          callback(callback_arg);
+        }
+      }
+    } while (busy);
   }
+}
 
-  // write solid bytes while we can - effectively doing 8 rows at a time
-  if (h >= 8) {
-    if (color == INVERSE)  {
-      // separate copy of the code so we don't impact performance of the
-      // black/white write version with an extra comparison per loop
-      do {
-        _operCache(x, y, TOGGLE_BITS, 0xFF);
-
-        // adjust h & y (there's got to be a faster way for me to do this, but
-        // this should still help a fair bit for now)
-        h -= 8;
-        y += 8;
-      } while (h >= 8);
-    } else {
-      // store a local value to work with
-      data = (color == WHITE) ? 0xFF : 0;
-
-      do  {
-	draw_pixel(x, y) = data;
-
-        // adjust h & y (there's got to be a faster way for me to do this, but
-        // this should still help a fair bit for now)
-        h -= 8;
-        y += 8;
-      } while (h >= 8);
-    }
-  }
-
-  // now do the final partial byte, if necessary
-  if (h) {
-    mod = h & 0x07;
-    // this time we want to mask the low bits of the byte, vs the high bits we
-    // did above
-    // register uint8 mask = (1 << mod) - 1;
-    // note - lookup table results in a nearly 10% performance improvement in
-    // fill* functions
-    static uint8 postmask[8] = {0x00, 0x01, 0x03, 0x07, 0x0F, 0x1F, 0x3F,
-                                  0x7F};
-    register uint8 mask = postmask[mod];
-
-    switch (color)
-    {
-      case WHITE:
-        _operCache(x, y, SET_BITS, mask);
-        break;
-      case BLACK:
-        _operCache(x, y, CLEAR_BITS, mask);
-        break;
-      case INVERSE:
-        _operCache(x, y, TOGGLE_BITS, mask);
-        break;
+// Hand the current frame to the flush task and return.  Only the dirty
+// spans are copied into the front buffer, as nothing else gets sent.  If
+// the previous frame is still in flight, this waits for it first.
+void SSD1306_dev_displayAsync(SSD1306_t *dev) {
+  uint8 *cache;
+
+  _flushIdleCreate(dev);
+  if (!_flushListed(dev)) {
+    taskENTER_CRITICAL();
+    dev->flush_next = _flush_list;
+    _flush_list = dev;
+    taskEXIT_CRITICAL();
+
+    if (!_flush_task) {
+      xTaskCreate(_flushTask, "SSD1306", SSD1306_FLUSH_TASK_STACK, NULL,
+                  SSD1306_FLUSH_TASK_PRIORITY, &_flush_task);
     }
   }
-}
 
-// From Adafruit_GFX base class, ported to PSoC with FreeRTOS (and C)
+  xSemaphoreTake(dev->flush_idle, portMAX_DELAY);
 
+#ifdef SSD1306_SHADOW_DIFF
+  if (!dev->shadow_valid) {
+    SSD1306_dev_markDirty(dev);
+  }
+#endif
 
-// Draw a circle outline
-void SSD1306_drawCircle(int16 x0, int16 y0, int16 r,
- uint16 color) {
-  int16 f = 1 - r;
-  int16 ddF_x = 1;
-  int16 ddF_y = -2 * r;
-  int16 x = 0;
-  int16 y = r;
+  if (dev->show_logo) {
+    cache = (uint8 *)lcd_logo;
+    SSD1306_dev_markDirty(dev);
+  } else {
+    cache = dev->draw_cache;
+  }
 
-  SSD1306_drawPixel(x0  , y0+r, color);
-  SSD1306_drawPixel(x0  , y0-r, color);
-  SSD1306_drawPixel(x0+r, y0  , color);
-  SSD1306_drawPixel(x0-r, y0  , color);
+  for (uint8 page = 0; page < _pages(dev); page++) {
+    uint8 x0 = dev->dirty_x0[page];
+    uint8 x1 = dev->dirty_x1[page];
 
-  while (x<y) {
-    if (f >= 0) {
-      y--;
-      ddF_y += 2;
-      f += ddF_y;
+    if (x0 <= x1) {
+      uint16 offset = SSD1306_PIXEL_ADDR(x0, page << 3);
+      memcpy(&dev->front_cache[offset], &cache[offset], x1 - x0 + 1);
     }
-    x++;
-    ddF_x += 2;
-    f += ddF_x;
+  }
+  memcpy(dev->front_x0, dev->dirty_x0, SSD1306_PAGES);
+  memcpy(dev->front_x1, dev->dirty_x1, SSD1306_PAGES);
+  SSD1306_dev_clearDirty(dev);
 
-    SSD1306_drawPixel(x0 + x, y0 + y, color);
-    SSD1306_drawPixel(x0 - x, y0 + y, color);
-    SSD1306_drawPixel(x0 + x, y0 - y, color);
-    SSD1306_drawPixel(x0 - x, y0 - y, color);
-    SSD1306_drawPixel(x0 + y, y0 + x, color);
-    SSD1306_drawPixel(x0 - y, y0 + x, color);
-    SSD1306_drawPixel(x0 + y, y0 - x, color);
-    SSD1306_drawPixel(x0 - y, y0 - x, color);
+  if (dev->show_logo) {
+    SSD1306_dev_clearDisplay(dev);
+  }
+
+  _flushBegin(dev, dev->front_cache, dev->front_x0, dev->front_x1);
+  dev->flush_pending = 1;
+  xTaskNotifyGive(_flush_task);
+}
+#else
+// Without SSD1306_ASYNC_FLUSH there is no front buffer to hand over, so
+// the frame is sent there and then
+void SSD1306_dev_displayAsync(SSD1306_t *dev) {
+  SSD1306_dev_display(dev);
+  if (dev->flush_callback) {
+    dev->flush_callback(dev->flush_callback_arg);
   }
 }
+#endif
 
-void SSD1306_drawCircleHelper( int16 x0, int16 y0,
- int16 r, uint8 cornername, uint16 color) {
-  int16 f     = 1 - r;
-  int16 ddF_x = 1;
-  int16 ddF_y = -2 * r;
-  int16 x     = 0;
-  int16 y     = r;
+// Wait up to ticks for this panel's frame to finish.  Returns pdTRUE if
+// no frame is in flight.
+int SSD1306_dev_displayWait(SSD1306_t *dev, TickType_t ticks) {
+  if (!dev->flush_idle) {
+    return pdTRUE;
+  }
 
-  while (x<y) {
-    if (f >= 0) {
-      y--;
-      ddF_y += 2;
-      f     += ddF_y;
-    }
-    x++;
-    ddF_x += 2;
-    f     += ddF_x;
-    if (cornername & 0x4) {
-      SSD1306_drawPixel(x0 + x, y0 + y, color);
-      SSD1306_drawPixel(x0 + y, y0 + x, color);
-    }
-    if (cornername & 0x2) {
-      SSD1306_drawPixel(x0 + x, y0 - y, color);
-      SSD1306_drawPixel(x0 + y, y0 - x, color);
-    }
-    if (cornername & 0x8) {
-      SSD1306_drawPixel(x0 - y, y0 + x, color);
-      SSD1306_drawPixel(x0 - x, y0 + y, color);
-    }
-    if (cornername & 0x1) {
-      SSD1306_drawPixel(x0 - y, y0 - x, color);
-      SSD1306_drawPixel(x0 - x, y0 - y, color);
-    }
+  if (xSemaphoreTake(dev->flush_idle, ticks) != pdTRUE) {
+    return pdFALSE;
   }
+  xSemaphoreGive(dev->flush_idle);
+  return pdTRUE;
 }
 
-void SSD1306_fillCircle(int16 x0, int16 y0, int16 r,
- uint16 color) {
-  SSD1306_drawFastVLine(x0, y0-r, 2*r+1, color);
-  SSD1306_fillCircleHelper(x0, y0, r, 3, 0, color);
+// Byte counts of the last flush, and the running total saved over plain
+// dirty span flushing
+void SSD1306_dev_getFlushStats(SSD1306_t *dev, SSD1306_flushStats_t *stats) {
+  *stats = dev->stats;
 }
 
-// Used to do circles and roundrects
-void SSD1306_fillCircleHelper(int16 x0, int16 y0, int16 r,
- uint8 cornername, int16 delta, uint16 color) {
-
-  int16 f     = 1 - r;
-  int16 ddF_x = 1;
-  int16 ddF_y = -2 * r;
-  int16 x     = 0;
-  int16 y     = r;
+void SSD1306_dev_resetFlushStats(SSD1306_t *dev) {
+  memset(&dev->stats, 0, sizeof(dev->stats));
+}
 
-  while (x<y) {
-    if (f >= 0) {
-      y--;
-      ddF_y += 2;
-      f     += ddF_y;
-    }
-    x++;
-    ddF_x += 2;
-    f     += ddF_x;
+// Called each time a frame from SSD1306_dev_displayAsync() has been sent,
+// from the flush task with SSD1306_ASYNC_FLUSH
+void SSD1306_dev_setFlushCallback(SSD1306_t *dev, void (*callback)(void *arg), void *arg) {
+  dev->flush_callback = callback;
+  dev->flush_callback_arg = arg;
+}
 
-    if (cornername & 0x1) {
-      SSD1306_drawFastVLine(x0+x, y0-y, 2*y+1+delta, color);
-      SSD1306_drawFastVLine(x0+y, y0-x, 2*x+1+delta, color);
-    }
-    if (cornername & 0x2) {
-      SSD1306_drawFastVLine(x0-x, y0-y, 2*y+1+delta, color);
-      SSD1306_drawFastVLine(x0-y, y0-x, 2*x+1+delta, color);
-    }
-  }
+// clear everything
+void SSD1306_dev_clearDisplay(SSD1306_t *dev) {
+  dev->show_logo = 0;
+  memset(dev->draw_cache, 0, SSD1306_RAM_MIRROR_SIZE);
+  SSD1306_dev_markDirty(dev);
 }
 
-// Bresenham's algorithm - thx wikpedia
-void SSD1306_drawLine(int16 x0, int16 y0, int16 x1, int16 y1,
- uint16 color) {
-  int16 steep = _abs(y1 - y0) > _abs(x1 - x0);
-  if (steep) {
-    _swap_int16(x0, y0);
-    _swap_int16(x1, y1);
-  }
+// Map a logical (rotated) coordinate onto the raw display
+#define _rawX(dev, x, y) ((dev)->rot_x0 + (dev)->rot_xx * (x) + (dev)->rot_xy * (y))
+#define _rawY(dev, x, y) ((dev)->rot_y0 + (dev)->rot_yx * (x) + (dev)->rot_yy * (y))
 
-  if (x0 > x1) {
-    _swap_int16(x0, x1);
-    _swap_int16(y0, y1);
-  }
+// Set one pixel in logical coordinates with an already resolved color
+static void _plot(SSD1306_t *dev, int16 x, int16 y, const rop_t *rop)
+{
+  if ((x < 0) || (x >= dev->width) || (y < 0) || (y >= dev->height))
+    return;
 
-  int16 dx, dy;
-  dx = x1 - x0;
-  dy = _abs(y1 - y0);
+  int16 rx = _rawX(dev, x, y);
+  int16 ry = _rawY(dev, x, y);
+  uint8 mask = SSD1306_PIXEL_MASK(ry);
+  uint8 *addr = &draw_pixel(rx, ry);
 
-  int16 err = dx / 2;
-  int16 ystep;
+  *addr = (*addr & ~(mask & rop->clr)) ^ (mask & rop->flip);
+  _markDirty(dev, ry >> 3, rx, rx);
+}
 
-  if (y0 < y1) {
-    ystep = 1;
-  } else {
-    ystep = -1;
+// the most basic function, set a single pixel
+void SSD1306_dev_drawPixel(SSD1306_t *dev, int16 x, int16 y, uint16 color) {
+  const rop_t *rop = _colorRop(color);
+  if (!rop) {
+    return;
   }
 
-  for (; x0<=x1; x0++) {
-    if (steep) {
-      SSD1306_drawPixel(y0, x0, color);
-    } else {
-      SSD1306_drawPixel(x0, y0, color);
-    }
-    err -= dy;
-    if (err < 0) {
-      y0 += ystep;
-      err += dx;
-    }
-  }
+  _plot(dev, x, y, rop);
 }
 
-// Draw a rectangle
-void SSD1306_drawRect(int16 x, int16 y, int16 w, int16 h,
- uint16 color) {
-  SSD1306_drawFastHLine(x, y, w, color);
-  SSD1306_drawFastHLine(x, y+h-1, w, color);
-  SSD1306_drawFastVLine(x, y, h, color);
-  SSD1306_drawFastVLine(x+w-1, y, h, color);
+void SSD1306_dev_drawFastHLine(SSD1306_t *dev, int16 x, int16 y, int16 w, uint16 color) {
+  const rop_t *rop = _colorRop(color);
+  if (!rop) {
+    return;
+  }
+
+  _fillRectRotated(dev, x, y, w, 1, rop);
 }
 
-void SSD1306_fillRect(int16 x, int16 y, int16 w, int16 h,
- uint16 color) {
-  // Update in subclasses if desired!
-  for (int16 i=x; i<x+w; i++) {
-    SSD1306_drawFastVLine(i, y, h, color);
+void SSD1306_dev_drawFastVLine(SSD1306_t *dev, int16 x, int16 y, int16 h, uint16 color) {
+  const rop_t *rop = _colorRop(color);
+  if (!rop) {
+    return;
   }
-}
 
-void SSD1306_fillScreen(uint16 color) {
-  SSD1306_fillRect(0, 0, _width, _height, color);
+  _fillRectRotated(dev, x, y, 1, h, rop);
 }
 
-// Draw a rounded rectangle
-void SSD1306_drawRoundRect(int16 x, int16 y, int16 w,
- int16 h, int16 r, uint16 color) {
-  // smarter version
-  SSD1306_drawFastHLine(x+r  , y    , w-2*r, color); // Top
-  SSD1306_drawFastHLine(x+r  , y+h-1, w-2*r, color); // Bottom
-  SSD1306_drawFastVLine(x    , y+r  , h-2*r, color); // Left
-  SSD1306_drawFastVLine(x+w-1, y+r  , h-2*r, color); // Right
-  // draw four corners
-  SSD1306_drawCircleHelper(x+r    , y+r    , r, 1, color);
-  SSD1306_drawCircleHelper(x+w-r-1, y+r    , r, 2, color);
-  SSD1306_drawCircleHelper(x+w-r-1, y+h-r-1, r, 4, color);
-  SSD1306_drawCircleHelper(x+r    , y+h-r-1, r, 8, color);
-}
+// Apply one page mask to a run of w bytes.  Runs long enough to matter are
+// done a word at a time once the pointer is aligned, through memcpy so the
+// word accesses can't be reordered against the byte ones around them.
+static void _fillPageSpan(uint8 *addr, int16 w, uint8 mask, const rop_t *rop)
+{
+  uint8 clr = mask & rop->clr;
+  uint8 flip = mask & rop->flip;
 
-// Fill a rounded rectangle
-void SSD1306_fillRoundRect(int16 x, int16 y, int16 w,
- int16 h, int16 r, uint16 color) {
-  // smarter version
-  SSD1306_fillRect(x+r, y, w-2*r, h, color);
+  if (clr == 0xFF) {
+    memset(addr, flip, w);
+    return;
+  }
 
-  // draw four corners
-  SSD1306_fillCircleHelper(x+w-r-1, y+r, r, 1, h-2*r-1, color);
-  SSD1306_fillCircleHelper(x+r    , y+r, r, 2, h-2*r-1, color);
-}
+  uint32 clr32 = clr * 0x01010101UL;
+  uint32 flip32 = flip * 0x01010101UL;
+
+  for (; w && ((uintptr_t)addr & 0x03); w--, addr++) {
+    *addr = (*addr & ~clr) ^ flip;
+  }
+  for (; w >= 4; w -= 4, addr += 4) {
+    uint32 word;
+
+    memcpy(&word, addr, 4);
+    word = (word & ~clr32) ^ flip32;
+    memcpy(addr, &word, 4);
+  }
+  for (; w; w--, addr++) {
+    *addr = (*addr & ~clr) ^ flip;
+  }
+}
+
+// Fill a rectangle in raw (unrotated) display coordinates.  Clips once,
+// then walks the pages it covers writing whole rows of bytes, masking only
+// the top and bottom pages.
+static void _fillRectInternal(SSD1306_t *dev, int16 x, int16 y, int16 w, int16 h, const rop_t *rop) {
+  if (x < 0) {
+    w += x;
+    x = 0;
+  }
+  if (y < 0) {
+    h += y;
+    y = 0;
+  }
+  if ((x + w) > dev->WIDTH) {
+    w = dev->WIDTH - x;
+  }
+  if ((y + h) > dev->HEIGHT) {
+    h = dev->HEIGHT - y;
+  }
+  if (w <= 0 || h <= 0) {
+    return;
+  }
+
+  uint8 page = y >> 3;
+  uint8 last = (y + h - 1) >> 3;
+  uint8 topmask = 0xFF << (y & 0x07);
+  uint8 botmask = 0xFF >> (7 - ((y + h - 1) & 0x07));
+  uint8 *addr = &draw_pixel(x, y);
+
+  if (page == last) {
+    _fillPageSpan(addr, w, topmask & botmask, rop);
+    _markDirty(dev, page, x, x + w - 1);
+    return;
+  }
+
+  _fillPageSpan(addr, w, topmask, rop);
+  _markDirty(dev, page, x, x + w - 1);
+
+  for (page++, addr += SSD1306_LCDWIDTH; page < last; page++, addr += SSD1306_LCDWIDTH) {
+    _fillPageSpan(addr, w, 0xFF, rop);
+    _markDirty(dev, page, x, x + w - 1);
+  }
+
+  _fillPageSpan(addr, w, botmask, rop);
+  _markDirty(dev, page, x, x + w - 1);
+}
+
+// Fill a rectangle given in logical coordinates: map two opposite corners
+// through the rotation and fill the raw rectangle between them.
+static void _fillRectRotated(SSD1306_t *dev, int16 x, int16 y, int16 w, int16 h, const rop_t *rop) {
+  if (w <= 0 || h <= 0) {
+    return;
+  }
+
+  int16 x0 = _rawX(dev, x, y);
+  int16 y0 = _rawY(dev, x, y);
+  int16 x1 = _rawX(dev, x + w - 1, y + h - 1);
+  int16 y1 = _rawY(dev, x + w - 1, y + h - 1);
+
+  if (x0 > x1) _swap_int16(x0, x1);
+  if (y0 > y1) _swap_int16(y0, y1);
+
+  _fillRectInternal(dev, x0, y0, x1 - x0 + 1, y1 - y0 + 1, rop);
+}
+
+// Spans gathered a page of raw rows at a time.  Each span toggles its
+// row's bit at both ends; a running XOR along the page then gives every
+// column's mask, so the page is written once rather than once per row.
+// Spans in a row must not overlap.
+typedef struct {
+  int16 page;               // Raw page being gathered, -1 for none
+  int16 x0;                 // Raw columns touched
+  int16 x1;
+  uint8 edge[SSD1306_LCDWIDTH + 1];
+} spanPage_t;
+
+static void _spanBegin(spanPage_t *sp)
+{
+  memset(sp->edge, 0, sizeof(sp->edge));
+  sp->page = -1;
+}
+
+static void _spanFlush(SSD1306_t *dev, spanPage_t *sp, const rop_t *rop)
+{
+  if (sp->page < 0) {
+    return;
+  }
+
+  uint8 *addr = &dev->draw_cache[sp->page * SSD1306_LCDWIDTH + sp->x0];
+  uint8 mask = 0;
+
+  for (int16 x = sp->x0; x <= sp->x1; x++, addr++) {
+    mask ^= sp->edge[x];
+    sp->edge[x] = 0;
+    *addr = (*addr & ~(mask & rop->clr)) ^ (mask & rop->flip);
+  }
+  sp->edge[sp->x1 + 1] = 0;
+
+  _markDirty(dev, sp->page, sp->x0, sp->x1);
+  sp->page = -1;
+}
+
+// Add the span rx0..rx1 of raw row ry, already on the screen
+static void _spanRaw(SSD1306_t *dev, spanPage_t *sp, int16 rx0, int16 rx1, int16 ry,
+                     const rop_t *rop)
+{
+  uint8 bit = SSD1306_PIXEL_MASK(ry);
+
+  if (rx0 > rx1) _swap_int16(rx0, rx1);
+
+  if ((ry >> 3) != sp->page) {
+    _spanFlush(dev, sp, rop);
+    sp->page = ry >> 3;
+    sp->x0 = rx0;
+    sp->x1 = rx1;
+  }
+  sp->x0 = min(sp->x0, rx0);
+  sp->x1 = max(sp->x1, rx1);
+  sp->edge[rx0] ^= bit;
+  sp->edge[rx1 + 1] ^= bit;
+}
+
+// Add the logical span x..x1 of row y, which is on the screen.  When the
+// panel is on its side the span is a raw column, a page-native fill
+// already.
+static void _spanAdd(SSD1306_t *dev, spanPage_t *sp, int16 x, int16 x1, int16 y, const rop_t *rop)
+{
+  x = max(x, 0);
+  x1 = min(x1, dev->width - 1);
+  if (x > x1) {
+    return;
+  }
+
+  if (dev->rotation & 1) {
+    _fillRectRotated(dev, x, y, x1 - x + 1, 1, rop);
+  } else {
+    _spanRaw(dev, sp, _rawX(dev, x, y), _rawX(dev, x1, y), _rawY(dev, x, y), rop);
+  }
+}
+
+// Add the logical span y..y1 of column x, clipping it to the screen
+static void _spanAddV(SSD1306_t *dev, spanPage_t *sp, int16 x, int16 y, int16 y1, const rop_t *rop)
+{
+  y = max(y, 0);
+  y1 = min(y1, dev->height - 1);
+  if (x < 0 || x >= dev->width || y > y1) {
+    return;
+  }
+
+  if (dev->rotation & 1) {
+    _spanRaw(dev, sp, _rawX(dev, x, y), _rawX(dev, x, y1), _rawY(dev, x, y), rop);
+  } else {
+    _fillRectRotated(dev, x, y, 1, y1 - y + 1, rop);
+  }
+}
+
+// From Adafruit_GFX base class, ported to PSoC with FreeRTOS (and C)
+
+
+// Outlines are drawn in raw coordinates about the raw centre: turning the
+// panel only swaps and negates offsets, which the eight way symmetry of
+// the midpoint circle already covers.  A circle wholly on the screen is
+// plotted without any bounds checks and marked dirty once for its box.
+typedef struct {
+  int16 cx;                 // Raw centre
+  int16 cy;
+  int16 r;
+  uint8 clip;               // Some of it is off the screen
+} rawCircle_t;
+
+// Returns 0 if none of the circle can be seen
+static uint8 _rawCircleBegin(SSD1306_t *dev, rawCircle_t *c, int16 x0, int16 y0, int16 r)
+{
+  c->cx = _rawX(dev, x0, y0);
+  c->cy = _rawY(dev, x0, y0);
+  c->r = r;
+
+  if (r < 0 || c->cx + r < 0 || c->cx - r >= dev->WIDTH ||
+      c->cy + r < 0 || c->cy - r >= dev->HEIGHT) {
+    return 0;
+  }
+
+  c->clip = (c->cx - r < 0 || c->cx + r >= dev->WIDTH ||
+             c->cy - r < 0 || c->cy + r >= dev->HEIGHT);
+  return 1;
+}
+
+static inline void _rawCirclePlot(SSD1306_t *dev, const rawCircle_t *c, int16 dx, int16 dy,
+                                  const rop_t *rop)
+{
+  int16 rx = c->cx + dx;
+  int16 ry = c->cy + dy;
+
+  if (c->clip && ((uint16)rx >= dev->WIDTH || (uint16)ry >= dev->HEIGHT)) {
+    return;
+  }
+
+  uint8 mask = SSD1306_PIXEL_MASK(ry);
+  uint8 *addr = &draw_pixel(rx, ry);
+  *addr = (*addr & ~(mask & rop->clr)) ^ (mask & rop->flip);
+}
+
+// Mark the box around the raw quadrants drawn, numbered as for
+// drawCircleHelper()
+static void _rawCircleDirty(SSD1306_t *dev, const rawCircle_t *c, uint8 corners)
+{
+  int16 x0 = max(c->cx - ((corners & 0x9) ? c->r : 0), 0);
+  int16 x1 = min(c->cx + ((corners & 0x6) ? c->r : 0), dev->WIDTH - 1);
+  int16 y0 = max(c->cy - ((corners & 0x3) ? c->r : 0), 0);
+  int16 y1 = min(c->cy + ((corners & 0xC) ? c->r : 0), dev->HEIGHT - 1);
+
+  if (x0 > x1 || y0 > y1) {
+    return;
+  }
+
+  for (int16 page = y0 >> 3; page <= (y1 >> 3); page++) {
+    _markDirty(dev, page, x0, x1);
+  }
+}
+
+// Draw a circle outline
+void SSD1306_dev_drawCircle(SSD1306_t *dev, int16 x0, int16 y0, int16 r,
+ uint16 color) {
+  int16 f = 1 - r;
+  int16 ddF_x = 1;
+  int16 ddF_y = -2 * r;
+  int16 x = 0;
+  int16 y = r;
+  const rop_t *rop = _colorRop(color);
+  rawCircle_t c;
+
+  if (!rop || !_rawCircleBegin(dev, &c, x0, y0, r)) {
+    return;
+  }
+
+  _rawCirclePlot(dev, &c,  0,  r, rop);
+  _rawCirclePlot(dev, &c,  0, -r, rop);
+  _rawCirclePlot(dev, &c,  r,  0, rop);
+  _rawCirclePlot(dev, &c, -r,  0, rop);
+
+  while (x<y) {
+    if (f >= 0) {
+      y--;
+      ddF_y += 2;
+      f += ddF_y;
+    }
+    x++;
+    ddF_x += 2;
+    f += ddF_x;
+
+    _rawCirclePlot(dev, &c,  x,  y, rop);
+    _rawCirclePlot(dev, &c, -x,  y, rop);
+    _rawCirclePlot(dev, &c,  x, -y, rop);
+    _rawCirclePlot(dev, &c, -x, -y, rop);
+    _rawCirclePlot(dev, &c,  y,  x, rop);
+    _rawCirclePlot(dev, &c, -y,  x, rop);
+    _rawCirclePlot(dev, &c,  y, -x, rop);
+    _rawCirclePlot(dev, &c, -y, -x, rop);
+  }
+
+  _rawCircleDirty(dev, &c, 0xF);
+}
+
+// cornername picks logical quadrants: 1 up and left, 2 up and right,
+// 4 down and right, 8 down and left.  Each is turned into the raw
+// quadrant it lands on before drawing.
+void SSD1306_dev_drawCircleHelper(SSD1306_t *dev,  int16 x0, int16 y0,
+ int16 r, uint8 cornername, uint16 color) {
+  int16 f     = 1 - r;
+  int16 ddF_x = 1;
+  int16 ddF_y = -2 * r;
+  int16 x     = 0;
+  int16 y     = r;
+  const rop_t *rop = _colorRop(color);
+  rawCircle_t c;
+  uint8 corners = 0;
+
+  if (!rop || !_rawCircleBegin(dev, &c, x0, y0, r)) {
+    return;
+  }
+
+  for (uint8 i = 0; i < 4; i++) {
+    static const int8 sx[4] = { -1, 1, 1, -1 };
+    static const int8 sy[4] = { -1, -1, 1, 1 };
+
+    if (cornername & (1 << i)) {
+      int8 rsx = dev->rot_xx * sx[i] + dev->rot_xy * sy[i];
+      int8 rsy = dev->rot_yx * sx[i] + dev->rot_yy * sy[i];
+      corners |= (rsy < 0) ? ((rsx < 0) ? 0x1 : 0x2) : ((rsx < 0) ? 0x8 : 0x4);
+    }
+  }
+
+  while (x<y) {
+    if (f >= 0) {
+      y--;
+      ddF_y += 2;
+      f     += ddF_y;
+    }
+    x++;
+    ddF_x += 2;
+    f     += ddF_x;
+    if (corners & 0x4) {
+      _rawCirclePlot(dev, &c,  x,  y, rop);
+      _rawCirclePlot(dev, &c,  y,  x, rop);
+    }
+    if (corners & 0x2) {
+      _rawCirclePlot(dev, &c,  x, -y, rop);
+      _rawCirclePlot(dev, &c,  y, -x, rop);
+    }
+    if (corners & 0x8) {
+      _rawCirclePlot(dev, &c, -y,  x, rop);
+      _rawCirclePlot(dev, &c, -x,  y, rop);
+    }
+    if (corners & 0x1) {
+      _rawCirclePlot(dev, &c, -y, -x, rop);
+      _rawCirclePlot(dev, &c, -x, -y, rop);
+    }
+  }
+
+  _rawCircleDirty(dev, &c, corners);
+}
+
+
+// Column dx out from x0 of a filled circle or corner: half rows either
+// side of y0, and delta more below.  The centre column is left to the
+// caller, which covers it anyway.
+static void _circleColumn(SSD1306_t *dev, spanPage_t *sp, int16 x0, int16 y0, int16 dx,
+                          int16 half, int16 delta, const rop_t *rop)
+{
+  if (dx) {
+    _spanAddV(dev, sp, x0 + dx, y0 - half, y0 + half + delta, rop);
+  }
+}
+
+// One side of a filled circle, the same shape fillCircleHelper() has
+// always drawn but with each column filled once.  The midpoint loop gives
+// column x a span from (x, y) and column y one from its mirror (y, x).
+// Columns short of where the loop stops only get the first kind, columns
+// beyond it only the second; the one or two columns in between get both,
+// and are held back until both are known.
+static void _circleSpans(SSD1306_t *dev, spanPage_t *sp, int16 x0, int16 y0, int16 r,
+                         int8 side, int16 delta, const rop_t *rop)
+{
+  int16 f     = 1 - r;
+  int16 ddF_x = 1;
+  int16 ddF_y = -2 * r;
+  int16 x     = 0;
+  int16 y     = r;
+
+  // Find where the loop stops
+  while (x<y) {
+    if (f >= 0) {
+      y--;
+      ddF_y += 2;
+      f     += ddF_y;
+    }
+    x++;
+    ddF_x += 2;
+    f     += ddF_x;
+  }
+
+  int16 xe = x;
+  int16 ye = y;
+  int16 meet[2] = { -1, -1 };
+
+  if (!xe) {
+    return;
+  }
+
+  f     = 1 - r;
+  ddF_x = 1;
+  ddF_y = -2 * r;
+  x     = 0;
+  y     = r;
+
+  while (x<y) {
+    if (f >= 0) {
+      // Column y has had its last and widest span from the mirror
+      if (x) {
+        if (y > xe) {
+          _circleColumn(dev, sp, x0, y0, side * y, x, delta, rop);
+        } else {
+          meet[y - ye] = max(meet[y - ye], x);
+        }
+      }
+      y--;
+      ddF_y += 2;
+      f     += ddF_y;
+    }
+    x++;
+    ddF_x += 2;
+    f     += ddF_x;
+
+    if (x < ye) {
+      _circleColumn(dev, sp, x0, y0, side * x, y, delta, rop);
+    } else {
+      meet[x - ye] = max(meet[x - ye], y);
+    }
+  }
+  meet[0] = max(meet[0], xe);
+
+  for (uint8 i = 0; i < 2; i++) {
+    if (meet[i] >= 0) {
+      _circleColumn(dev, sp, x0, y0, side * (ye + i), meet[i], delta, rop);
+    }
+  }
+}
+
+// Fill a circle or the corners of a rounded rectangle whose centre
+// column is filled separately
+static void _fillCorners(SSD1306_t *dev, int16 x0, int16 y0, int16 r,
+                         uint8 cornername, int16 delta, const rop_t *rop)
+{
+  spanPage_t sp;
+  _spanBegin(&sp);
+
+  if (cornername & 0x1) {
+    _circleSpans(dev, &sp, x0, y0, r, 1, delta, rop);
+  }
+  if (cornername & 0x2) {
+    _circleSpans(dev, &sp, x0, y0, r, -1, delta, rop);
+  }
+
+  _spanFlush(dev, &sp, rop);
+}
+
+void SSD1306_dev_fillCircle(SSD1306_t *dev, int16 x0, int16 y0, int16 r,
+ uint16 color) {
+  const rop_t *rop = _colorRop(color);
+  if (!rop) {
+    return;
+  }
+
+  _fillRectRotated(dev, x0, y0-r, 1, 2*r+1, rop);
+  _fillCorners(dev, x0, y0, r, 3, 0, rop);
+}
+
+// Used to do circles and roundrects
+void SSD1306_dev_fillCircleHelper(SSD1306_t *dev, int16 x0, int16 y0, int16 r,
+ uint8 cornername, int16 delta, uint16 color) {
+  const rop_t *rop = _colorRop(color);
+  if (!rop) {
+    return;
+  }
+
+  _fillCorners(dev, x0, y0, r, cornername, delta, rop);
+
+  // The loop only reaches the centre column for a radius of 1
+  if (r == 1 && (cornername & 0x3)) {
+    _fillRectRotated(dev, x0, y0 - 1, 1, 3 + delta, rop);
+  }
+}
+
+// Half heights of a filled ellipse, a column at a time outwards from its
+// centre.  A pixel dx, dy out is inside when
+//   dx^2 ry^2 + dy^2 rx^2 <= rx^2 ry^2 + rx ry (rx + ry) / 2
+// which for a circle is x^2 + y^2 <= r^2 + r, near enough the midpoint
+// circle.  Both terms are kept by adding odd numbers, so there is no
+// multiply or divide per column, and the height only ever shrinks.
+// Radii are limited to 200 to keep the terms in 32 bits.
+#define SSD1306_MAX_ELLIPSE 200
+
+typedef struct {
+  int32 a;                  // dx^2 ry^2
+  int32 b;                  // dy^2 rx^2
+  int32 t;                  // Threshold
+  int32 rx2;
+  int32 ry2;
+  int16 dx;
+  int16 dy;
+} ellipseRows_t;
+
+static void _ellipseBegin(ellipseRows_t *e, int16 rx, int16 ry)
+{
+  e->rx2 = (int32)rx * rx;
+  e->ry2 = (int32)ry * ry;
+  e->a = 0;
+  e->b = e->rx2 * e->ry2;
+  e->t = e->b + (int32)rx * ry * (rx + ry) / 2;
+  e->dx = 0;
+  e->dy = ry;
+}
+
+// Half height of the current column, -1 if it is empty, then move out
+static int16 _ellipseNext(ellipseRows_t *e)
+{
+  while (e->dy >= 0 && e->a + e->b > e->t) {
+    e->b -= (2 * (int32)e->dy - 1) * e->rx2;
+    e->dy--;
+  }
+  e->a += (2 * (int32)e->dx + 1) * e->ry2;
+  e->dx++;
+  return e->dy;
+}
+
+void SSD1306_dev_fillEllipse(SSD1306_t *dev, int16 x0, int16 y0, int16 rx,
+ int16 ry, uint16 color) {
+  const rop_t *rop = _colorRop(color);
+  if (!rop || rx < 0 || ry < 0 || rx > SSD1306_MAX_ELLIPSE ||
+      ry > SSD1306_MAX_ELLIPSE) {
+    return;
+  }
+
+  spanPage_t sp;
+  _spanBegin(&sp);
+
+  // One side at a time, so neighbouring columns share a page when the
+  // panel is on its side
+  for (int8 side = 1; side >= -1; side -= 2) {
+    ellipseRows_t e;
+    _ellipseBegin(&e, rx, ry);
+    if (side < 0) {
+      _ellipseNext(&e);
+    }
+    for (int16 dx = e.dx; dx <= rx; dx++) {
+      int16 half = _ellipseNext(&e);
+      _spanAddV(dev, &sp, x0 + side * dx, y0 - half, y0 + half, rop);
+    }
+  }
+
+  _spanFlush(dev, &sp, rop);
+}
+
+// sin() of 0 to 90 degrees, in Q14
+static const int16 _sinQ14[91] = {
+  0, 286, 572, 857, 1143, 1428, 1713, 1997, 2280, 2563,
+  2845, 3126, 3406, 3686, 3964, 4240, 4516, 4790, 5063, 5334,
+  5604, 5872, 6138, 6402, 6664, 6924, 7182, 7438, 7692, 7943,
+  8192, 8438, 8682, 8923, 9162, 9397, 9630, 9860, 10087, 10311,
+  10531, 10749, 10963, 11174, 11381, 11585, 11786, 11982, 12176, 12365,
+  12551, 12733, 12911, 13085, 13255, 13421, 13583, 13741, 13894, 14044,
+  14189, 14330, 14466, 14598, 14726, 14849, 14968, 15082, 15191, 15296,
+  15396, 15491, 15582, 15668, 15749, 15826, 15897, 15964, 16026, 16083,
+  16135, 16182, 16225, 16262, 16294, 16322, 16344, 16362, 16374, 16382,
+  16384
+};
+
+static int16 _sinDeg(int16 deg)
+{
+  deg %= 360;
+  if (deg < 0) {
+    deg += 360;
+  }
+  if (deg < 90) {
+    return _sinQ14[deg];
+  } else if (deg < 180) {
+    return _sinQ14[180 - deg];
+  } else if (deg < 270) {
+    return -_sinQ14[deg - 180];
+  }
+  return -_sinQ14[360 - deg];
+}
+
+#define _cosDeg(deg)  _sinDeg((deg) + 90)
+
+// One side of an arc's wedge: the rows of column dx with
+// cx * dy >= cy * dx.  The bound is cy * dx / cx rounded the right way,
+// stepped one column at a time as a quotient and remainder so only the
+// setup divides.
+typedef struct {
+  int32 q;                  // floor(n * k / d)
+  int32 rem;
+  int32 qstep;
+  int32 rstep;
+  int32 d;
+  int32 cy;                 // Sign of the whole test when cx is 0
+  int8 below;               // Rows from the bound down, rather than up
+} arcEdge_t;
+
+// Start at column 0, stepping one column each way given by side
+static void _arcEdgeBegin(arcEdge_t *e, int32 cx, int32 cy, int8 side)
+{
+  int32 n;
+
+  e->below = (cx > 0);
+  e->d = e->below ? cx : -cx;
+  n = side * (e->below ? cy : -cy);
+  e->cy = side * cy;
+  e->q = 0;
+  e->rem = 0;
+
+  if (e->d) {
+    e->qstep = n / e->d;
+    e->rstep = n % e->d;
+    if (e->rstep < 0) {
+      e->rstep += e->d;
+      e->qstep--;
+    }
+  }
+}
+
+// Rows lo..hi of column k on this side, then move out a column
+static void _arcEdgeNext(arcEdge_t *e, int16 k, int16 *lo, int16 *hi)
+{
+  *lo = -32767;
+  *hi = 32767;
+
+  if (!e->d) {
+    if (e->cy * k > 0) {
+      *lo = 0;
+      *hi = -1;
+    }
+    return;
+  }
+
+  if (e->below) {
+    *lo = e->q + (e->rem != 0);
+  } else {
+    *hi = e->q;
+  }
+
+  e->q += e->qstep;
+  e->rem += e->rstep;
+  if (e->rem >= e->d) {
+    e->rem -= e->d;
+    e->q++;
+  }
+}
+
+// Fill the part of the ring lo..hi of a column inside the wedge, given as
+// one or two rows ranges
+static void _arcColumn(SSD1306_t *dev, spanPage_t *sp, int16 x, int16 y0,
+                       int16 lo, int16 hi, const int16 *wedge, uint8 count,
+                       const rop_t *rop)
+{
+  for (uint8 i = 0; i < count; i++) {
+    int16 y = max(lo, wedge[2 * i]);
+    int16 y1 = min(hi, wedge[2 * i + 1]);
+    if (y <= y1) {
+      _spanAddV(dev, sp, x, y0 + y, y0 + y1, rop);
+    }
+  }
+}
+
+// Fill the sector of a ring between start and end degrees, clockwise from
+// three o'clock.  The ring is the outer disc less an inner one, each from
+// an ellipse walker, and the sector is the part between the two edge rays:
+// both their half planes for up to half a turn, either of them beyond.
+// All are found a column at a time, and each column filled once.
+void SSD1306_dev_fillArc(SSD1306_t *dev, int16 x0, int16 y0, int16 r,
+ int16 thickness, int16 start, int16 end, uint16 color) {
+  const rop_t *rop = _colorRop(color);
+  int16 sweep = end - start;
+  int16 ri = r - thickness;
+
+  if (!rop || r < 0 || r > SSD1306_MAX_ELLIPSE || thickness <= 0 || !sweep) {
+    return;
+  }
+  if (sweep < 360) {
+    sweep %= 360;
+    if (sweep <= 0) {
+      sweep += 360;
+    }
+  }
+
+  // The start ray and its clockwise side, the end ray and its other side
+  int32 ax = _cosDeg(start);
+  int32 ay = _sinDeg(start);
+  int32 bx = -_cosDeg(start + sweep);
+  int32 by = -_sinDeg(start + sweep);
+
+  spanPage_t sp;
+  _spanBegin(&sp);
+
+  for (int8 side = 1; side >= -1; side -= 2) {
+    ellipseRows_t outer;
+    ellipseRows_t inner;
+    arcEdge_t ea;
+    arcEdge_t eb;
+
+    _ellipseBegin(&outer, r, r);
+    _ellipseBegin(&inner, ri, ri);
+    _arcEdgeBegin(&ea, ax, ay, side);
+    _arcEdgeBegin(&eb, bx, by, side);
+
+    for (int16 k = 0; k <= r; k++) {
+      int16 ho = _ellipseNext(&outer);
+      int16 hi = (ri >= 0 && k <= ri) ? _ellipseNext(&inner) : -1;
+      int16 wedge[4];
+      uint8 count = 1;
+
+      _arcEdgeNext(&ea, k, &wedge[0], &wedge[1]);
+      _arcEdgeNext(&eb, k, &wedge[2], &wedge[3]);
+
+      if (side < 0 && !k) {
+        continue;
+      }
+
+      if (sweep >= 360) {
+        wedge[0] = -32767;
+        wedge[1] = 32767;
+      } else if (sweep <= 180) {
+        wedge[0] = max(wedge[0], wedge[2]);
+        wedge[1] = min(wedge[1], wedge[3]);
+      } else if (wedge[0] > wedge[1]) {
+        wedge[0] = wedge[2];
+        wedge[1] = wedge[3];
+      } else if (wedge[2] <= wedge[3]) {
+        // Either side: one range if they meet, otherwise two in order
+        if (max(wedge[0], wedge[2]) <= min(wedge[1], wedge[3]) + 1) {
+          wedge[0] = min(wedge[0], wedge[2]);
+          wedge[1] = max(wedge[1], wedge[3]);
+        } else {
+          count = 2;
+          if (wedge[2] < wedge[0]) {
+            _swap_int16(wedge[0], wedge[2]);
+            _swap_int16(wedge[1], wedge[3]);
+          }
+        }
+      }
+
+      int16 x = x0 + side * k;
+      if (hi < 0) {
+        _arcColumn(dev, &sp, x, y0, -ho, ho, wedge, count, rop);
+      } else {
+        _arcColumn(dev, &sp, x, y0, -ho, -hi - 1, wedge, count, rop);
+        _arcColumn(dev, &sp, x, y0, hi + 1, ho, wedge, count, rop);
+      }
+    }
+  }
+
+  _spanFlush(dev, &sp, rop);
+}
+
+void SSD1306_dev_fillPie(SSD1306_t *dev, int16 x0, int16 y0, int16 r,
+ int16 start, int16 end, uint16 color) {
+  SSD1306_dev_fillArc(dev, x0, y0, r, r + 1, start, end, color);
+}
+
+// Cohen-Sutherland outcode of a logical point against the screen
+#define OUT_LEFT    0x01
+#define OUT_RIGHT   0x02
+#define OUT_TOP     0x04
+#define OUT_BOTTOM  0x08
+
+static uint8 _outcode(SSD1306_t *dev, int16 x, int16 y)
+{
+  uint8 code = 0;
+
+  if (x < 0) {
+    code |= OUT_LEFT;
+  } else if (x >= dev->width) {
+    code |= OUT_RIGHT;
+  }
+  if (y < 0) {
+    code |= OUT_TOP;
+  } else if (y >= dev->height) {
+    code |= OUT_BOTTOM;
+  }
+  return code;
+}
+
+// n pixels from raw rx, ry, each a step of sx, sy from the last with one
+// of the two 0, so the run is along a raw row or down a raw column
+static void _plotRun(SSD1306_t *dev, int16 rx, int16 ry, int8 sx, int8 sy, int16 n,
+                     const rop_t *rop)
+{
+  if (sy) {
+    if (sy < 0) {
+      ry -= n - 1;
+    }
+
+    // A byte per page the run crosses
+    int16 y1 = ry + n - 1;
+    uint8 *addr = &draw_pixel(rx, ry);
+    uint8 mask = 0xFF << (ry & 0x07);
+
+    for (uint8 page = ry >> 3; ; page++, addr += SSD1306_LCDWIDTH, mask = 0xFF) {
+      uint8 last = (page == (y1 >> 3));
+      if (last) {
+        mask &= 0xFF >> (7 - (y1 & 0x07));
+      }
+      *addr = (*addr & ~(mask & rop->clr)) ^ (mask & rop->flip);
+      _markDirty(dev, page, rx, rx);
+      if (last) {
+        return;
+      }
+    }
+  }
+
+  if (sx < 0) {
+    rx -= n - 1;
+  }
+  _fillPageSpan(&draw_pixel(rx, ry), n, SSD1306_PIXEL_MASK(ry), rop);
+  _markDirty(dev, ry >> 3, rx, rx + n - 1);
+}
+
+// Bresenham's algorithm - thx wikpedia
+//
+// The pixels are the same ones it has always drawn, but taken a run at a
+// time: every pixel until the minor axis steps shares a row or column, and
+// is filled as one span.  Run lengths alternate between dx / dy and one
+// more, picked by a remainder, so the loop does not divide.  Clipping
+// works out the first and last steps on the screen from the error term
+// directly, and rotation is resolved into raw steps along and across the
+// line before it starts.
+void SSD1306_dev_drawLine(SSD1306_t *dev, int16 x0, int16 y0, int16 x1, int16 y1,
+ uint16 color) {
+  const rop_t *rop = _colorRop(color);
+  if (!rop || (_outcode(dev, x0, y0) & _outcode(dev, x1, y1))) {
+    return;
+  }
+
+  int16 steep = _abs(y1 - y0) > _abs(x1 - x0);
+  if (steep) {
+    _swap_int16(x0, y0);
+    _swap_int16(x1, y1);
+  }
+
+  if (x0 > x1) {
+    _swap_int16(x0, x1);
+    _swap_int16(y0, y1);
+  }
+
+  int32 dx, dy;
+  dx = x1 - x0;
+  dy = _abs(y1 - y0);
+
+  int32 err = dx / 2;
+  int16 ystep;
+
+  if (y0 < y1) {
+    ystep = 1;
+  } else {
+    ystep = -1;
+  }
+
+  // Steps k along the line that stay on the screen.  After k steps the
+  // line has moved n(k) = ceil((k * dy - err) / dx) across it.
+  int16 umax = (steep ? dev->height : dev->width) - 1;
+  int16 vmax = (steep ? dev->width : dev->height) - 1;
+  int32 nlo = (ystep > 0) ? -y0 : y0 - vmax;
+  int32 nhi = (ystep > 0) ? vmax - y0 : y0;
+  int32 k = max(0, -x0);
+  int32 kend = min(dx, umax - x0);
+
+  if (nhi < 0 || nlo > dy) {
+    return;
+  }
+  if (nlo > 0) {
+    k = max(k, ((nlo - 1) * dx + err + dy) / dy);
+  }
+  if (nhi < dy) {
+    kend = min(kend, (nhi * dx + err + dy) / dy - 1);
+  }
+  if (k > kend) {
+    return;
+  }
+
+  int32 n = dx ? (k * dy - err + dx - 1) / dx : 0;
+  err += n * dx - k * dy;
+  x0 += k;
+  y0 += ystep * n;
+
+  // Raw steps along the line (u) and across it (v)
+  int16 rx, ry;
+  int8 ux, uy, vx, vy;
+  if (steep) {
+    rx = _rawX(dev, y0, x0);
+    ry = _rawY(dev, y0, x0);
+    ux = dev->rot_xy;
+    uy = dev->rot_yy;
+    vx = ystep * dev->rot_xx;
+    vy = ystep * dev->rot_yx;
+  } else {
+    rx = _rawX(dev, x0, y0);
+    ry = _rawY(dev, x0, y0);
+    ux = dev->rot_xx;
+    uy = dev->rot_yx;
+    vx = ystep * dev->rot_xy;
+    vy = ystep * dev->rot_yy;
+  }
+
+  // The current run is a + 1 pixels long, with b left over
+  int16 left = kend - k + 1;
+  int32 a = 0, b = 0, q = 0, r = 0;
+  if (dy) {
+    a = err / dy;
+    b = err % dy;
+    q = dx / dy;
+    r = dx % dy;
+  }
+
+  while (left > 0) {
+    int16 run = dy ? min(a + 1, left) : left;
+
+    _plotRun(dev, rx, ry, ux, uy, run, rop);
+    left -= run;
+    rx += ux * run + vx;
+    ry += uy * run + vy;
+
+    b += r;
+    if (b >= dy) {
+      b -= dy;
+      a = q;
+    } else {
+      a = q - 1;
+    }
+  }
+}
+
+// Draw a rectangle
+void SSD1306_dev_drawRect(SSD1306_t *dev, int16 x, int16 y, int16 w, int16 h,
+ uint16 color) {
+  SSD1306_dev_drawFastHLine(dev, x, y, w, color);
+  SSD1306_dev_drawFastHLine(dev, x, y+h-1, w, color);
+  SSD1306_dev_drawFastVLine(dev, x, y, h, color);
+  SSD1306_dev_drawFastVLine(dev, x+w-1, y, h, color);
+}
+
+void SSD1306_dev_fillRect(SSD1306_t *dev, int16 x, int16 y, int16 w, int16 h,
+ uint16 color) {
+  const rop_t *rop = _colorRop(color);
+  if (!rop) {
+    return;
+  }
+
+  _fillRectRotated(dev, x, y, w, h, rop);
+}
+
+void SSD1306_dev_fillScreen(SSD1306_t *dev, uint16 color) {
+  SSD1306_dev_fillRect(dev, 0, 0, dev->width, dev->height, color);
+}
+
+// One step of a vertical shift: the bits of a moved by s, with the bits
+// carried in from the neighbouring page b.  Works on a byte or on four
+// columns at once given masks repeated per byte.
+static inline uint32 _shiftBits(uint32 a, uint32 b, uint8 s, uint32 ma, uint32 mb, uint8 down)
+{
+  if (down) {
+    return ((a << s) & ma) | ((b >> (8 - s)) & mb);
+  }
+  return ((a >> s) & ma) | ((b << (8 - s)) & mb);
+}
+
+// Shift one page row of a region vertically by s bits, merging the result
+// into dst under mask.  a is the source page most bits come from and b
+// the page next to it (NULL for none).  dst, a and b share an alignment,
+// so runs are done a word at a time like _fillPageSpan.
+static void _shiftPageSpan(uint8 *dst, const uint8 *a, const uint8 *b, int16 w,
+                           uint8 s, uint8 mask, uint8 down)
+{
+  uint8 ma = down ? (uint8)(0xFF << s) : (0xFF >> s);
+  uint8 mb = b ? (uint8)~ma : 0;
+
+  if (!b) {
+    b = a;
+  }
+
+  uint32 ma32 = ma * 0x01010101UL;
+  uint32 mb32 = mb * 0x01010101UL;
+  uint32 mask32 = mask * 0x01010101UL;
+
+  for (; w && ((uintptr_t)dst & 0x03); w--, dst++, a++, b++) {
+    *dst = (*dst & ~mask) | (_shiftBits(*a, *b, s, ma, mb, down) & mask);
+  }
+  for (; w >= 4; w -= 4, dst += 4, a += 4, b += 4) {
+    uint32 wa, wb, word;
+
+    memcpy(&wa, a, 4);
+    memcpy(&wb, b, 4);
+    memcpy(&word, dst, 4);
+    word = (word & ~mask32) | (_shiftBits(wa, wb, s, ma32, mb32, down) & mask32);
+    memcpy(dst, &word, 4);
+  }
+  for (; w; w--, dst++, a++, b++) {
+    *dst = (*dst & ~mask) | (_shiftBits(*a, *b, s, ma, mb, down) & mask);
+  }
+}
+
+// Move the pixels of a raw rectangle by (dx, dy), both smaller than the
+// rectangle.  Pixels moved in from outside it are left for the caller to
+// fill.
+static void _shiftRectInternal(SSD1306_t *dev, int16 x, int16 y, int16 w, int16 h,
+                               int16 dx, int16 dy)
+{
+  uint8 first = y >> 3;
+  uint8 last = (y + h - 1) >> 3;
+  uint8 topmask = 0xFF << (y & 0x07);
+  uint8 botmask = 0xFF >> (7 - ((y + h - 1) & 0x07));
+  uint8 page;
+
+  // Horizontal: whole pages are a memmove, the partial top and bottom
+  // pages are merged a column at a time
+  if (dx) {
+    int16 n = w - _abs(dx);
+    int16 from = (dx > 0) ? x : x - dx;
+    int16 to = (dx > 0) ? x + dx : x;
+
+    for (page = first; page <= last; page++) {
+      uint8 mask = ((page == first) ? topmask : 0xFF) & ((page == last) ? botmask : 0xFF);
+      uint8 *row = &dev->draw_cache[page * SSD1306_LCDWIDTH];
+
+      if (mask == 0xFF) {
+        memmove(&row[to], &row[from], n);
+      } else if (dx > 0) {
+        for (int16 i = n - 1; i >= 0; i--) {
+          row[to + i] = (row[to + i] & ~mask) | (row[from + i] & mask);
+        }
+      } else {
+        for (int16 i = 0; i < n; i++) {
+          row[to + i] = (row[to + i] & ~mask) | (row[from + i] & mask);
+        }
+      }
+    }
+  }
+
+  // Vertical: each page takes whole pages of offset q, carrying the low
+  // or high s bits in from the page next to its source.  Only the rows
+  // that receive moved pixels are written, so the rows left uncovered keep
+  // their old pixels for the caller to fill.
+  if (dy) {
+    uint8 q = _abs(dy) >> 3;
+    uint8 s = _abs(dy) & 0x07;
+    int16 r0 = (dy > 0) ? y + dy : y;
+    int16 r1 = (dy > 0) ? y + h - 1 : y + h - 1 + dy;
+    uint8 dfirst = r0 >> 3;
+    uint8 dlast = r1 >> 3;
+    uint8 dtopmask = 0xFF << (r0 & 0x07);
+    uint8 dbotmask = 0xFF >> (7 - (r1 & 0x07));
+
+    for (int16 i = 0; i <= last - first; i++) {
+      int16 p = (dy > 0) ? last - i : first + i;
+      int16 pa = (dy > 0) ? p - q : p + q;
+      int16 pb = (dy > 0) ? pa - 1 : pa + 1;
+      uint8 mask = ((p == dfirst) ? dtopmask : 0xFF) & ((p == dlast) ? dbotmask : 0xFF);
+
+      if (p < dfirst || p > dlast) {
+        continue;
+      }
+
+      _shiftPageSpan(&draw_pixel(x, p << 3), &draw_pixel(x, pa << 3),
+                     (pb < first || pb > last) ? NULL : &draw_pixel(x, pb << 3),
+                     w, s, mask, dy > 0);
+    }
+  }
+
+  for (page = first; page <= last; page++) {
+    _markDirty(dev, page, x, x + w - 1);
+  }
+}
+
+// Scroll the contents of a rectangle by (dx, dy) in place, filling what is
+// uncovered with fill.  Returns the uncovered strip (the bounding box of
+// both strips when moving diagonally), clipped to the screen.
+SSD1306_rect_t SSD1306_dev_scrollRegion(SSD1306_t *dev, int16 x, int16 y, int16 w, int16 h,
+                                        int16 dx, int16 dy, uint16 fill)
+{
+  SSD1306_rect_t exposed = { 0, 0, 0, 0 };
+  const rop_t *rop = _colorRop(fill);
+
+  if (x < 0) {
+    w += x;
+    x = 0;
+  }
+  if (y < 0) {
+    h += y;
+    y = 0;
+  }
+  if ((x + w) > dev->width) {
+    w = dev->width - x;
+  }
+  if ((y + h) > dev->height) {
+    h = dev->height - y;
+  }
+  if (w <= 0 || h <= 0 || (!dx && !dy)) {
+    return exposed;
+  }
+
+  exposed.x = x;
+  exposed.y = y;
+  exposed.w = w;
+  exposed.h = h;
+
+  if (_abs(dx) < w && _abs(dy) < h) {
+    // Map the rectangle and the offset onto the raw display
+    int16 x0 = _rawX(dev, x, y);
+    int16 y0 = _rawY(dev, x, y);
+    int16 x1 = _rawX(dev, x + w - 1, y + h - 1);
+    int16 y1 = _rawY(dev, x + w - 1, y + h - 1);
+
+    if (x0 > x1) _swap_int16(x0, x1);
+    if (y0 > y1) _swap_int16(y0, y1);
+
+    _shiftRectInternal(dev, x0, y0, x1 - x0 + 1, y1 - y0 + 1,
+                       dev->rot_xx * dx + dev->rot_xy * dy,
+                       dev->rot_yx * dx + dev->rot_yy * dy);
+
+    if (!dy) {
+      exposed.w = _abs(dx);
+      exposed.x = (dx > 0) ? x : x + w + dx;
+    } else if (!dx) {
+      exposed.h = _abs(dy);
+      exposed.y = (dy > 0) ? y : y + h + dy;
+    }
+  }
+
+  if (rop) {
+    int16 n;
+    if (dx) {
+      n = min(_abs(dx), w);
+      _fillRectRotated(dev, (dx > 0) ? x : x + w - n, y, n, h, rop);
+    }
+    if (dy) {
+      n = min(_abs(dy), h);
+      _fillRectRotated(dev, x, (dy > 0) ? y : y + h - n, w, n, rop);
+    }
+  }
+
+  return exposed;
+}
+
+// Row a chart value is plotted on
+static int16 _chartRow(SSD1306_chart_t *chart, int16 value)
+{
+  int32 range = (int32)chart->max - chart->min;
+
+  if (range <= 0) {
+    return chart->y + chart->h - 1;
+  }
+
+  value = clamp(value, chart->min, chart->max);
+  return chart->y + chart->h - 1 -
+         (int16)(((int32)value - chart->min) * (chart->h - 1) / range);
+}
+
+// Ring slot of the sample j pushes old, and how many are on show
+#define _chartSlot(chart, j) (((chart)->head + (chart)->w - (j)) % ((chart)->w + 1))
+#define _chartShown(chart) min((chart)->count, (chart)->w)
+
+// Draw the column of the sample j pushes old: a vertical span joining it
+// to the sample before, so the columns read as a line.  The ring keeps one
+// sample more than is shown so the leftmost column redraws the same way.
+static void _chartColumn(SSD1306_t *dev, SSD1306_chart_t *chart, uint8 j)
+{
+  int16 y0 = _chartRow(chart, chart->samples[_chartSlot(chart, j)]);
+  int16 y1 = (j + 1 < chart->count) ? _chartRow(chart, chart->samples[_chartSlot(chart, j + 1)]) : y0;
+
+  if (y0 > y1) _swap_int16(y0, y1);
+  SSD1306_dev_drawFastVLine(dev, chart->x + chart->w - 1 - j, y0, y1 - y0 + 1, chart->color);
+}
+
+// Fit the scale to the samples on show.  Returns whether it changed.
+static uint8 _chartFit(SSD1306_chart_t *chart)
+{
+  int16 lo = chart->samples[_chartSlot(chart, 0)];
+  int16 hi = lo;
+
+  for (uint8 j = 1; j < _chartShown(chart); j++) {
+    int16 v = chart->samples[_chartSlot(chart, j)];
+    lo = min(lo, v);
+    hi = max(hi, v);
+  }
+
+  if (lo == chart->min && hi == chart->max) {
+    return 0;
+  }
+  chart->min = lo;
+  chart->max = hi;
+  return 1;
+}
+
+void SSD1306_dev_chartBegin(SSD1306_t *dev, SSD1306_chart_t *chart, int16 x, int16 y,
+                            uint8 w, uint8 h, int16 *samples, int16 min, int16 max,
+                            uint16 color, uint16 bg)
+{
+  chart->x = x;
+  chart->y = y;
+  chart->w = w;
+  chart->h = h;
+  chart->samples = samples;
+  chart->head = 0;
+  chart->count = 0;
+  chart->autoscale = (min == max);
+  chart->min = min;
+  chart->max = max;
+  chart->color = color;
+  chart->bg = bg;
+
+  SSD1306_dev_fillRect(dev, x, y, w, h, bg);
+}
+
+// Clear the chart's area and plot every sample on show
+void SSD1306_dev_chartRedraw(SSD1306_t *dev, SSD1306_chart_t *chart)
+{
+  SSD1306_dev_fillRect(dev, chart->x, chart->y, chart->w, chart->h, chart->bg);
+  for (uint8 j = 0; j < _chartShown(chart); j++) {
+    _chartColumn(dev, chart, j);
+  }
+}
+
+// Add a sample.  Only rescans the samples for autoscaling when the new
+// one is out of range or the one scrolled off may have been an extreme.
+void SSD1306_dev_chartPush(SSD1306_t *dev, SSD1306_chart_t *chart, int16 value)
+{
+  if (!chart->w) {
+    return;
+  }
+
+  chart->samples[chart->head] = value;
+  chart->head = (chart->head + 1) % (chart->w + 1);
+  if (chart->count <= chart->w) {
+    chart->count++;
+  }
+
+  if (chart->autoscale) {
+    int16 gone = chart->samples[_chartSlot(chart, chart->w)];
+    uint8 rescan = (chart->count == 1) || (value < chart->min) || (value > chart->max) ||
+                   ((chart->count > chart->w) && ((gone == chart->min) || (gone == chart->max)));
+
+    if (rescan && _chartFit(chart)) {
+      SSD1306_dev_chartRedraw(dev, chart);
+      return;
+    }
+  }
+
+  SSD1306_dev_scrollRegion(dev, chart->x, chart->y, chart->w, chart->h, -1, 0, chart->bg);
+  _chartColumn(dev, chart, 0);
+}
+
+// Draw a rounded rectangle
+void SSD1306_dev_drawRoundRect(SSD1306_t *dev, int16 x, int16 y, int16 w,
+ int16 h, int16 r, uint16 color) {
+  // smarter version
+  SSD1306_dev_drawFastHLine(dev, x+r  , y    , w-2*r, color); // Top
+  SSD1306_dev_drawFastHLine(dev, x+r  , y+h-1, w-2*r, color); // Bottom
+  SSD1306_dev_drawFastVLine(dev, x    , y+r  , h-2*r, color); // Left
+  SSD1306_dev_drawFastVLine(dev, x+w-1, y+r  , h-2*r, color); // Right
+  // draw four corners
+  SSD1306_dev_drawCircleHelper(dev, x+r    , y+r    , r, 1, color);
+  SSD1306_dev_drawCircleHelper(dev, x+w-r-1, y+r    , r, 2, color);
+  SSD1306_dev_drawCircleHelper(dev, x+w-r-1, y+h-r-1, r, 4, color);
+  SSD1306_dev_drawCircleHelper(dev, x+r    , y+h-r-1, r, 8, color);
+}
+
+// Fill a rounded rectangle
+void SSD1306_dev_fillRoundRect(SSD1306_t *dev, int16 x, int16 y, int16 w,
+ int16 h, int16 r, uint16 color) {
+  const rop_t *rop = _colorRop(color);
+  if (!rop) {
+    return;
+  }
+
+  // Corners any rounder would overlap
+  r = min(r, min(w, h) / 2);
+
+  // smarter version
+  _fillRectRotated(dev, x+r, y, w-2*r, h, rop);
+
+  // draw four corners
+  _fillCorners(dev, x+w-r-1, y+r, r, 1, h-2*r-1, rop);
+  _fillCorners(dev, x+r    , y+r, r, 2, h-2*r-1, rop);
+}
 
 // Draw a triangle
-void SSD1306_drawTriangle(int16 x0, int16 y0,
+void SSD1306_dev_drawTriangle(SSD1306_t *dev, int16 x0, int16 y0,
  int16 x1, int16 y1, int16 x2, int16 y2, uint16 color) {
-  SSD1306_drawLine(x0, y0, x1, y1, color);
-  SSD1306_drawLine(x1, y1, x2, y2, color);
-  SSD1306_drawLine(x2, y2, x0, y0, color);
+  SSD1306_dev_drawLine(dev, x0, y0, x1, y1, color);
+  SSD1306_dev_drawLine(dev, x1, y1, x2, y2, color);
+  SSD1306_dev_drawLine(dev, x2, y2, x0, y0, color);
+}
+
+// A polygon edge stepped down a row at a time without dividing: x moves
+// by step each row plus one more in the direction of travel whenever the
+// remainder overflows, tracking x_top + (x_bot - x_top) * n / dy with the
+// quotient truncated towards zero as fillTriangle() always has.
+typedef struct {
+  int16 y0;                 // First row
+  int16 y1;                 // Row it ends on
+  int16 x;
+  int16 step;
+  int16 rem;
+  int16 err;
+  int16 dy;
+  int8 dir;
+} polyEdge_t;
+
+static void _edgeBegin(polyEdge_t *e, int16 x0, int16 y0, int16 x1, int16 y1, int16 ystart)
+{
+  int16 adx = _abs(x1 - x0);
+
+  e->y0 = y0;
+  e->y1 = y1;
+  e->dy = y1 - y0;
+  e->dir = (x1 < x0) ? -1 : 1;
+  e->step = e->dir * (adx / e->dy);
+  e->rem = adx % e->dy;
+  e->x = x0;
+  e->err = 0;
+
+  // Jump straight to the first row drawn when clipped at the top
+  if (ystart > y0) {
+    int32 n = (int32)adx * (ystart - y0);
+    e->x += e->dir * (int16)(n / e->dy);
+    e->err = n % e->dy;
+  }
+}
+
+static inline void _edgeStep(polyEdge_t *e)
+{
+  e->x += e->step;
+  e->err += e->rem;
+  if (e->err >= e->dy) {
+    e->err -= e->dy;
+    e->x += e->dir;
+  }
+}
+
+// Fill a polygon a row at a time from integer edge steppers, with the
+// even-odd rule.  An edge covers its rows from the top down to just
+// before its bottom, except at the polygon's last row, where the edges
+// ending there close it off.  Rows and edges are clipped up front.
+static void _fillPolygonInternal(SSD1306_t *dev, const SSD1306_point_t *pts, uint8 count,
+                                 const rop_t *rop)
+{
+  polyEdge_t edges[SSD1306_MAX_POLYGON];
+  int16 xs[SSD1306_MAX_POLYGON];
+  uint8 n = 0;
+  int16 top = pts[0].y;
+  int16 bot = pts[0].y;
+
+  for (uint8 i = 1; i < count; i++) {
+    top = min(top, pts[i].y);
+    bot = max(bot, pts[i].y);
+  }
+
+  int16 ystart = max(top, 0);
+  int16 yend = min(bot, dev->height - 1);
+  if (ystart > yend) {
+    return;
+  }
+
+  for (uint8 i = 0; i < count; i++) {
+    const SSD1306_point_t *p0 = &pts[i];
+    const SSD1306_point_t *p1 = &pts[(i + 1) % count];
+
+    if (p0->y == p1->y) {
+      continue;
+    }
+    if (p0->y > p1->y) {
+      const SSD1306_point_t *tmp = p0;
+      p0 = p1;
+      p1 = tmp;
+    }
+    if (p1->y < ystart || p0->y > yend) {
+      continue;
+    }
+    _edgeBegin(&edges[n++], p0->x, p0->y, p1->x, p1->y, ystart);
+  }
+
+  spanPage_t sp;
+  _spanBegin(&sp);
+
+  for (int16 y = ystart; y <= yend; y++) {
+    uint8 k = 0;
+
+    for (uint8 i = 0; i < n; i++) {
+      polyEdge_t *e = &edges[i];
+      if (y < e->y0 || y > e->y1 || (y == e->y1 && y != bot)) {
+        continue;
+      }
+
+      // Insertion sort as the crossings are found
+      int16 j = k++;
+      for (; j > 0 && xs[j - 1] > e->x; j--) {
+        xs[j] = xs[j - 1];
+      }
+      xs[j] = e->x;
+      _edgeStep(e);
+    }
+
+    // Pair the crossings up, joining spans that meet at a shared pixel
+    for (uint8 i = 0; i + 1 < k; i += 2) {
+      int16 x0 = xs[i];
+      int16 x1 = xs[i + 1];
+      while (i + 3 < k && xs[i + 2] <= x1) {
+        i += 2;
+        x1 = max(x1, xs[i + 1]);
+      }
+      _spanAdd(dev, &sp, x0, x1, y, rop);
+    }
+  }
+
+  _spanFlush(dev, &sp, rop);
+}
+
+void SSD1306_dev_fillPolygon(SSD1306_t *dev, const SSD1306_point_t *points, uint8 count,
+ uint16 color) {
+  const rop_t *rop = _colorRop(color);
+  if (!rop || count < 3 || count > SSD1306_MAX_POLYGON) {
+    return;
+  }
+
+  _fillPolygonInternal(dev, points, count, rop);
 }
 
 // Fill a triangle
-void SSD1306_fillTriangle(int16 x0, int16 y0,
+void SSD1306_dev_fillTriangle(SSD1306_t *dev, int16 x0, int16 y0,
  int16 x1, int16 y1, int16 x2, int16 y2, uint16 color) {
 
   int16 a, b, y, last;
+  const rop_t *rop = _colorRop(color);
+  if (!rop) {
+    return;
+  }
 
   // Sort coordinates by Y order (y2 >= y1 >= y0)
   if (y0 > y1) {
@@ -822,64 +2302,371 @@ void SSD1306_fillTriangle(int16 x0, int16 y0,
     _swap_int16(y0, y1); _swap_int16(x0, x1);
   }
 
-  if(y0 == y2) { // Handle awkward all-on-same-line case as its own thing
-    a = b = x0;
-    if(x1 < a)      a = x1;
-    else if(x1 > b) b = x1;
-    if(x2 < a)      a = x2;
-    else if(x2 > b) b = x2;
-    SSD1306_drawFastHLine(a, y0, b-a+1, color);
+  if(y0 == y2) { // Handle awkward all-on-same-line case as its own thing
+    a = min(x0, min(x1, x2));
+    b = max(x0, max(x1, x2));
+    _fillRectRotated(dev, a, y0, b-a+1, 1, rop);
+    return;
+  }
+
+  // Clip the rows up front; the edges start on the first one drawn
+  int16 ystart = max(y0, 0);
+  int16 yend = min(y2, dev->height - 1);
+  if (ystart > yend) {
+    return;
+  }
+
+  polyEdge_t e01, e02, e12;
+  spanPage_t sp;
+  _spanBegin(&sp);
+
+  _edgeBegin(&e02, x0, y0, x2, y2, ystart);
+
+  // For upper part of triangle, step along edges 0-1 and 0-2.  If y1=y2
+  // (flat-bottomed triangle), the scanline y1 is included here (and the
+  // second loop will be skipped), otherwise scanline y1 is skipped here
+  // and handled in the second loop, which also covers y0=y1
+  // (flat-topped triangle).
+  if(y1 == y2) last = y1;   // Include y1 scanline
+  else         last = y1-1; // Skip it
+  last = min(last, yend);
+
+  y = ystart;
+  if (y <= last) {
+    _edgeBegin(&e01, x0, y0, x1, y1, ystart);
+    for(; y<=last; y++) {
+      a = e01.x;
+      b = e02.x;
+      _edgeStep(&e01);
+      _edgeStep(&e02);
+      if(a > b) _swap_int16(a,b);
+      _spanAdd(dev, &sp, a, b, y, rop);
+    }
+  }
+
+  // For lower part of triangle, step along edges 1-2 and 0-2.  This loop
+  // is skipped if y1=y2.
+  if (y <= yend) {
+    _edgeBegin(&e12, x1, y1, x2, y2, y);
+    for(; y<=yend; y++) {
+      a = e12.x;
+      b = e02.x;
+      _edgeStep(&e12);
+      _edgeStep(&e02);
+      if(a > b) _swap_int16(a,b);
+      _spanAdd(dev, &sp, a, b, y, rop);
+    }
+  }
+
+  _spanFlush(dev, &sp, rop);
+}
+
+// What set and clear image bits do to the cache for each blit op
+static const rop_t *const _blitRops[][2] = {
+  { &_rops[WHITE],   &_rops[BLACK] },   // SSD1306_BLIT_COPY
+  { &_rops[WHITE],   &_ropNone },       // SSD1306_BLIT_OR
+  { &_ropNone,       &_rops[BLACK] },   // SSD1306_BLIT_AND
+  { &_rops[INVERSE], &_ropNone },       // SSD1306_BLIT_XOR
+  { &_rops[BLACK],   &_ropNone },       // SSD1306_BLIT_ANDNOT
+};
+
+// Merge an image in page layout, w columns by h rows with stride bytes
+// from one of its pages to the next, into the cache with its top left at
+// raw rx, ry.  Each cache byte takes the bits of up to two image pages,
+// shifted by ry within the page.  Set bits take the fg op and clear bits
+// the bg op in one read-modify-write, while bits outside the mask or below
+// the last row are left alone.  A page-aligned copy is a memcpy().
+static void _blitPages(SSD1306_t *dev, int16 rx, int16 ry, const uint8 *src,
+                       const uint8 *mask, int16 w, int16 h, int16 stride,
+                       const rop_t *fg, const rop_t *bg)
+{
+  if (w <= 0 || h <= 0) {
+    return;
+  }
+
+  int16 xs = max(rx, 0);
+  int16 xe = min(rx + w, dev->WIDTH);
+  int16 top = ry >> 3;
+  int16 p0 = max(top, 0);
+  int16 p1 = min((ry + h - 1) >> 3, _pages(dev) - 1);
+  if (xs >= xe || p0 > p1) {
+    return;
+  }
+
+  uint8 sh = ry & 0x07;
+  int16 spages = (h + 7) >> 3;
+  uint8 lastrows = 0xFF >> (spages * 8 - h);
+  uint8 copy = !mask && !sh && fg == &_rops[WHITE] && bg == &_rops[BLACK];
+  int16 n = xe - xs;
+
+  for (int16 page = p0; page <= p1; page++) {
+    // Image page a starts on this page, page a - 1 spills into it
+    int16 a = page - top;
+    int16 off = xs - rx;
+    const uint8 *sa = NULL, *sb = NULL, *ma = NULL, *mb = NULL;
+    uint8 ca = 0, cb = 0;
+    uint8 *addr = &dev->draw_cache[page * SSD1306_LCDWIDTH + xs];
+
+    if (a < spages) {
+      sa = &src[a * stride + off];
+      ma = mask ? &mask[a * stride + off] : NULL;
+      ca = (a == spages - 1) ? lastrows : 0xFF;
+    }
+    if (sh && a > 0) {
+      sb = &src[(a - 1) * stride + off];
+      mb = mask ? &mask[(a - 1) * stride + off] : NULL;
+      cb = (a == spages) ? lastrows : 0xFF;
+    }
+
+    if (copy && ca == 0xFF) {
+      memcpy(addr, sa, n);
+    } else {
+      for (int16 i = 0; i < n; i++) {
+        uint8 b = 0, m = 0;
+
+        if (sa) {
+          b = sa[i] << sh;
+          m = (ma ? (ma[i] & ca) : ca) << sh;
+        }
+        if (sb) {
+          b |= sb[i] >> (8 - sh);
+          m |= (mb ? (mb[i] & cb) : cb) >> (8 - sh);
+        }
+
+        uint8 f = b & m;
+        uint8 c = ~b & m;
+        uint8 clr = (f & fg->clr) | (c & bg->clr);
+        uint8 flip = (f & fg->flip) | (c & bg->flip);
+        addr[i] = (addr[i] & ~clr) ^ flip;
+      }
+    }
+    _markDirty(dev, page, xs, xe - 1);
+  }
+}
+
+void SSD1306_dev_blit(SSD1306_t *dev, int16 x, int16 y, const uint8 *bitmap,
+ const uint8 *mask, int16 w, int16 h, uint8 op) {
+  if (op >= NELEMS(_blitRops)) {
+    return;
+  }
+
+  _blitPages(dev, x, y, bitmap, mask, w, h, w, _blitRops[op][0], _blitRops[op][1]);
+}
+
+// Reverse the bits of a byte
+static uint8 _reverseBits(uint8 b)
+{
+  b = (b >> 4) | (b << 4);
+  b = ((b & 0xCC) >> 2) | ((b & 0x33) << 2);
+  b = ((b & 0xAA) >> 1) | ((b & 0x55) << 1);
+  return b;
+}
+
+// Eight pixels of row j of a row-major bitmap from column i on, with
+// pixel i in bit 0, or bit 7 when reversed.  Pixels off either end of the
+// row, or rows outside it, read as clear.  drawBitmap() images keep their
+// leftmost pixel in the top bit of each byte, XBM images in the bottom.
+static uint8 _bitmapRowBits(const uint8 *bitmap, int16 w, int16 h, int16 j, int16 i,
+                            uint8 xbm, uint8 reverse)
+{
+  int16 bw = (w + 7) / 8;
+  int16 b = i >> 3;
+  uint8 sh = i & 0x07;
+  uint8 lo, hi, bits;
+
+  if (j < 0 || j >= h) {
+    return 0;
+  }
+
+  lo = (b >= 0 && b < bw) ? bitmap[j * bw + b] : 0;
+  hi = (sh && b + 1 < bw) ? bitmap[j * bw + b + 1] : 0;
+
+  if (xbm) {
+    bits = (lo >> sh) | (hi << (8 - sh));
+  } else {
+    bits = (((uint16)lo << 8) | hi) << sh >> 8;
+    reverse = !reverse;
+  }
+
+  return reverse ? _reverseBits(bits) : bits;
+}
+
+// Transpose an 8x8 tile: bit k of out[n] is bit n of in[k].  Done as
+// three rounds of swapping ever smaller blocks within two words, after
+// Hacker's Delight.
+static void _transpose8(const uint8 *in, uint8 *out)
+{
+  uint32 x = ((uint32)in[7] << 24) | ((uint32)in[6] << 16) | ((uint32)in[5] << 8) | in[4];
+  uint32 y = ((uint32)in[3] << 24) | ((uint32)in[2] << 16) | ((uint32)in[1] << 8) | in[0];
+  uint32 t;
+
+  t = (x ^ (x >> 7)) & 0x00AA00AAUL;
+  x = x ^ t ^ (t << 7);
+  t = (y ^ (y >> 7)) & 0x00AA00AAUL;
+  y = y ^ t ^ (t << 7);
+
+  t = (x ^ (x >> 14)) & 0x0000CCCCUL;
+  x = x ^ t ^ (t << 14);
+  t = (y ^ (y >> 14)) & 0x0000CCCCUL;
+  y = y ^ t ^ (t << 14);
+
+  t = (x & 0xF0F0F0F0UL) | ((y >> 4) & 0x0F0F0F0FUL);
+  y = ((x << 4) & 0xF0F0F0F0UL) | (y & 0x0F0F0F0FUL);
+  x = t;
+
+  out[7] = x >> 24;
+  out[6] = x >> 16;
+  out[5] = x >> 8;
+  out[4] = x;
+  out[3] = y >> 24;
+  out[2] = y >> 16;
+  out[1] = y >> 8;
+  out[0] = y;
+}
+
+// Raw page p of a row-major bitmap drawn in the given rotation, columns
+// u0 to u1 - 1 of the raw image.  On its side, each row of the bitmap is
+// a raw column, so its bytes only need lining up; otherwise the rows are
+// turned into columns 8x8 at a time.
+static void _bitmapStrip(uint8 rotation, const uint8 *bitmap, int16 w, int16 h, uint8 xbm,
+                         int16 p, int16 u0, int16 u1, uint8 *out)
+{
+  if (rotation & 1) {
+    for (int16 u = u0; u < u1; u++) {
+      *out++ = (rotation == 1)
+        ? _bitmapRowBits(bitmap, w, h, h - 1 - u, 8 * p, xbm, 0)
+        : _bitmapRowBits(bitmap, w, h, u, w - 8 - 8 * p, xbm, 1);
+    }
+    return;
+  }
+
+  for (int16 ut = u0 & ~0x07; ut < u1; ut += 8) {
+    uint8 rows[8], cols[8];
+
+    for (uint8 k = 0; k < 8; k++) {
+      rows[k] = (rotation == 0)
+        ? _bitmapRowBits(bitmap, w, h, 8 * p + k, ut, xbm, 0)
+        : _bitmapRowBits(bitmap, w, h, h - 1 - 8 * p - k, w - 8 - ut, xbm, 1);
+    }
+    _transpose8(rows, cols);
+
+    for (uint8 n = 0; n < 8; n++) {
+      if (ut + n >= u0 && ut + n < u1) {
+        out[ut + n - u0] = cols[n];
+      }
+    }
+  }
+}
+
+void SSD1306_dev_forgetBitmaps(SSD1306_t *dev) {
+#ifdef SSD1306_BITMAP_CACHE
+  memset(dev->bitmap_cache, 0, sizeof(dev->bitmap_cache));
+  dev->bitmap_next = 0;
+  dev->bitmap_pool_next = 0;
+#else
+  (void)dev;
+#endif
+}
+
+#ifdef SSD1306_BITMAP_CACHE
+// A bitmap converted for the current rotation, raw width rw and height
+// rh, from the cache or converted into it.  NULL when it is too big to
+// keep.  The pool is handed out as a ring, dropping whatever the new
+// image lands on.
+static const uint8 *_cachedBitmap(SSD1306_t *dev, const uint8 *bitmap, int16 w, int16 h,
+                                  uint8 xbm, int16 rw, int16 rh)
+{
+  SSD1306_bitmapCache_t *entry;
+  // In 32 bits: a large enough image wraps a 16-bit length back to small
+  uint32 len32 = (uint32)rw * (uint32)((rh + 7) >> 3);
+
+  if (len32 > SSD1306_BITMAP_CACHE_BYTES) {
+    return NULL;
+  }
+  uint16 len = (uint16)len32;
+
+  for (uint8 i = 0; i < SSD1306_BITMAP_CACHE_SIZE; i++) {
+    entry = &dev->bitmap_cache[i];
+    if (entry->bitmap == bitmap && entry->w == w && entry->h == h &&
+        entry->xbm == xbm && entry->rotation == dev->rotation) {
+      return &dev->bitmap_pool[entry->offset];
+    }
+  }
+
+  if (dev->bitmap_pool_next + len > SSD1306_BITMAP_CACHE_BYTES) {
+    dev->bitmap_pool_next = 0;
+  }
+  uint16 offset = dev->bitmap_pool_next;
+  dev->bitmap_pool_next += len;
+
+  for (uint8 i = 0; i < SSD1306_BITMAP_CACHE_SIZE; i++) {
+    entry = &dev->bitmap_cache[i];
+    if (entry->bitmap && entry->offset < offset + len && offset < entry->offset + entry->len) {
+      entry->bitmap = NULL;
+    }
+  }
+
+  entry = &dev->bitmap_cache[dev->bitmap_next];
+  dev->bitmap_next = (dev->bitmap_next + 1) % SSD1306_BITMAP_CACHE_SIZE;
+
+  uint8 *img = &dev->bitmap_pool[offset];
+  for (int16 p = 0; p < (rh + 7) >> 3; p++) {
+    _bitmapStrip(dev->rotation, bitmap, w, h, xbm, p, 0, rw, &img[p * rw]);
+  }
+
+  entry->bitmap = bitmap;
+  entry->w = w;
+  entry->h = h;
+  entry->xbm = xbm;
+  entry->rotation = dev->rotation;
+  entry->offset = offset;
+  entry->len = len;
+  return img;
+}
+#endif
+
+// Draw a row-major bitmap at logical x, y: set bits take the fg op and
+// clear bits the bg op.  Only the raw pages and columns on the screen are
+// converted, a page at a time, and each page is blitted as it is made.
+static void _drawRowBitmap(SSD1306_t *dev, int16 x, int16 y, const uint8 *bitmap,
+                           int16 w, int16 h, uint8 xbm, const rop_t *fg, const rop_t *bg)
+{
+  if (w <= 0 || h <= 0 || (fg == &_ropNone && bg == &_ropNone)) {
+    return;
+  }
+
+  // Raw bounding box
+  int16 x0 = _rawX(dev, x, y);
+  int16 y0 = _rawY(dev, x, y);
+  int16 x1 = _rawX(dev, x + w - 1, y + h - 1);
+  int16 y1 = _rawY(dev, x + w - 1, y + h - 1);
+  int16 rx = min(x0, x1);
+  int16 ry = min(y0, y1);
+  int16 rw = (dev->rotation & 1) ? h : w;
+  int16 rh = (dev->rotation & 1) ? w : h;
+
+  // Columns and rows of the raw image on the screen
+  int16 u0 = max(0, -rx);
+  int16 u1 = min(rw, dev->WIDTH - rx);
+  int16 v0 = max(0, -ry);
+  int16 v1 = min(rh, dev->HEIGHT - ry);
+  if (u0 >= u1 || v0 >= v1) {
     return;
   }
 
-  int16
-    dx01 = x1 - x0,
-    dy01 = y1 - y0,
-    dx02 = x2 - x0,
-    dy02 = y2 - y0,
-    dx12 = x2 - x1,
-    dy12 = y2 - y1;
-  int32
-    sa   = 0,
-    sb   = 0;
-
-  // For upper part of triangle, find scanline crossings for segments
-  // 0-1 and 0-2.  If y1=y2 (flat-bottomed triangle), the scanline y1
-  // is included here (and second loop will be skipped, avoiding a /0
-  // error there), otherwise scanline y1 is skipped here and handled
-  // in the second loop...which also avoids a /0 error here if y0=y1
-  // (flat-topped triangle).
-  if(y1 == y2) last = y1;   // Include y1 scanline
-  else         last = y1-1; // Skip it
+#ifdef SSD1306_BITMAP_CACHE
+  const uint8 *img = _cachedBitmap(dev, bitmap, w, h, xbm, rw, rh);
+  if (img) {
+    _blitPages(dev, rx, ry, img, NULL, rw, rh, rw, fg, bg);
+    return;
+  }
+#endif
 
-  for(y=y0; y<=last; y++) {
-    a   = x0 + sa / dy01;
-    b   = x0 + sb / dy02;
-    sa += dx01;
-    sb += dx02;
-    /* longhand:
-    a = x0 + (x1 - x0) * (y - y0) / (y1 - y0);
-    b = x0 + (x2 - x0) * (y - y0) / (y2 - y0);
-    */
-    if(a > b) _swap_int16(a,b);
-    SSD1306_drawFastHLine(a, y, b-a+1, color);
-  }
-
-  // For lower part of triangle, find scanline crossings for segments
-  // 0-2 and 1-2.  This loop is skipped if y1=y2.
-  sa = dx12 * (y - y1);
-  sb = dx02 * (y - y0);
-  for(; y<=y2; y++) {
-    a   = x1 + sa / dy12;
-    b   = x0 + sb / dy02;
-    sa += dx12;
-    sb += dx02;
-    /* longhand:
-    a = x1 + (x2 - x1) * (y - y1) / (y2 - y1);
-    b = x0 + (x2 - x0) * (y - y0) / (y2 - y0);
-    */
-    if(a > b) _swap_int16(a,b);
-    SSD1306_drawFastHLine(a, y, b-a+1, color);
+  uint8 strip[SSD1306_LCDWIDTH];
+  for (int16 p = v0 >> 3; p <= (v1 - 1) >> 3; p++) {
+    _bitmapStrip(dev->rotation, bitmap, w, h, xbm, p, u0, u1, strip);
+    _blitPages(dev, rx + u0, ry + 8 * p, strip, NULL, u1 - u0, min(8, rh - 8 * p),
+               u1 - u0, fg, bg);
   }
 }
 
@@ -887,99 +2674,479 @@ void SSD1306_fillTriangle(int16 x0, int16 y0,
 // provided bitmap buffer using the specified foreground (for set bits)
 // and background (for clear bits) colors.
 // If foreground and background are the same, unset bits are transparent
-void SSD1306_drawBitmap(int16 x, int16 y, uint8 *bitmap,
+void SSD1306_dev_drawBitmap(SSD1306_t *dev, int16 x, int16 y, uint8 *bitmap,
       int16 w, int16 h, uint16 color, uint16 bg) {
+  const rop_t *fgrop, *bgrop;
 
-  int16 i, j, byteWidth = (w + 7) / 8;
-  uint8 byte = 0;
-
-  for(j=0; j<h; j++) {
-    for(i=0; i<w; i++ ) {
-      if(i & 7) byte <<= 1;
-      else      byte   = bitmap[j * byteWidth + i / 8];
-      if(byte & 0x80) SSD1306_drawPixel(x+i, y+j, color);
-      else if(color != bg) SSD1306_drawPixel(x+i, y+j, bg);
-    }
-  }
+  _textRops(color, bg, &fgrop, &bgrop);
+  _drawRowBitmap(dev, x, y, bitmap, w, h, 0, fgrop, bgrop);
 }
 
 //Draw XBitMap Files (*.xbm), exported from GIMP,
 //Usage: Export from GIMP to *.xbm, rename *.xbm to *.c and open in editor.
 //C Array can be directly used with this function
-void SSD1306_drawXBitmap(int16 x, int16 y,
+void SSD1306_dev_drawXBitmap(SSD1306_t *dev, int16 x, int16 y,
  const uint8 *bitmap, int16 w, int16 h, uint16 color) {
+  const rop_t *fgrop = _colorRop(color);
+
+  _drawRowBitmap(dev, x, y, bitmap, w, h, 1, fgrop ? fgrop : &_ropNone, &_ropNone);
+}
+
+// Glyph for a code point in the current custom font, or NULL.  A
+// GFXfontEx is searched by range, a GFXfont indexed directly.
+static GFXglyph *_fontGlyph(SSD1306_t *dev, uint16 cp) {
+  const GFXfontEx *fx = dev->gfxFontEx;
+
+  if (fx) {
+    uint16 lo = 0, hi = fx->rangeCount;
+
+    while (lo < hi) {
+      uint16 mid = (lo + hi) >> 1;
+      GFXrange *r = &fx->ranges[mid];
+
+      if (cp < r->first) {
+        hi = mid;
+      } else if ((uint16)(cp - r->first) >= r->count) {
+        lo = mid + 1;
+      } else {
+        return &(fx->font.glyph[r->glyph + (cp - r->first)]);
+      }
+    }
+    return NULL;
+  }
 
-  int16 i, j, byteWidth = (w + 7) / 8;
-  uint8 byte = 0;
+  if ((cp < dev->gfxFont->first) || (cp > dev->gfxFont->last)) {
+    return NULL;
+  }
+  return &(dev->gfxFont->glyph[cp - dev->gfxFont->first]);
+}
 
-  for(j=0; j<h; j++) {
-    for(i=0; i<w; i++ ) {
-      if(i & 7) byte >>= 1;
-      else      byte   = bitmap[j * byteWidth + i / 8];
-      if(byte & 0x01) SSD1306_drawPixel(x+i, y+j, color);
+// Feed one byte of UTF-8.  Returns 1 with the code point in cp once a
+// character is complete.  Malformed input and characters beyond U+FFFF
+// are dropped.
+static int _utf8Decode(uint16 *acc, uint8 *pending, uint8 b, uint16 *cp) {
+  if ((b & 0xC0) == 0x80) {     // Continuation byte
+    if (!*pending) {
+      return 0;
     }
+    *acc = (*acc << 6) | (b & 0x3F);
+    if (--(*pending)) {
+      return 0;
+    }
+    *cp = *acc;
+    return 1;
+  }
+
+  *pending = 0;
+  if (b < 0x80) {
+    *cp = b;
+    return 1;
+  }
+  if ((b & 0xE0) == 0xC0) {
+    *acc = b & 0x1F;
+    *pending = 1;
+  } else if ((b & 0xF0) == 0xE0) {
+    *acc = b & 0x0F;
+    *pending = 2;
+  }
+  return 0;
+}
+
+// Next character of text written to the panel: bytes are UTF-8 while a
+// GFXfontEx is selected, and taken as they are otherwise
+static int _decodeChar(SSD1306_t *dev, uint8 b, uint16 *cp) {
+  if (!dev->gfxFontEx) {
+    *cp = b;
+    return 1;
   }
+  return _utf8Decode(&dev->utf8_cp, &dev->utf8_pending, b, cp);
 }
 
-size_t SSD1306_write(uint8 c) {
-  if(!_gfxFont) { // 'Classic' built-in font
+// Where a character lands when written at the cursor
+typedef struct {
+  int16 x;
+  int16 y;
+  uint16 c;
+} glyphPos_t;
+
+// Advance the cursor past one character, wrapping as write() does.
+// Returns 1, with its position in pos, if the character has something to
+// draw on screen.
+static int _layoutChar(SSD1306_t *dev, uint16 c, glyphPos_t *pos) {
+  int16 size = dev->textsize;
+
+  if(!dev->gfxFont) { // 'Classic' built-in font
 
     if(c == '\n') {
-      _cursor_y += _textsize*8;
-      _cursor_x  = 0;
+      dev->cursor_y += size*8;
+      dev->cursor_x  = 0;
     } else if(c == '\r') {
       // skip em
     } else {
-      if(_wrap && ((_cursor_x + _textsize * 6) >= _width)) { // Heading off edge?
-        _cursor_x  = 0;            // Reset x to zero
-        _cursor_y += _textsize * 8; // Advance y one line
+      if(dev->wrap && ((dev->cursor_x + size * 6) >= dev->width)) { // Heading off edge?
+        dev->cursor_x  = 0;            // Reset x to zero
+        dev->cursor_y += size * 8; // Advance y one line
       }
-      SSD1306_drawChar(_cursor_x, _cursor_y, c, _textcolor, _textbgcolor, _textsize);
-      _cursor_x += _textsize * 6;
+      pos->x = dev->cursor_x;
+      pos->y = dev->cursor_y;
+      pos->c = c;
+      dev->cursor_x += size * 6;
+
+      return !((pos->x >= dev->width)            || // Clip right
+               (pos->y >= dev->height)           || // Clip bottom
+               ((pos->x + 6 * size - 1) < 0) || // Clip left
+               ((pos->y + 8 * size - 1) < 0));  // Clip top
     }
 
   } else { // Custom font
 
     if(c == '\n') {
-      _cursor_x  = 0;
-      _cursor_y += (int16)_textsize * _gfxFont->yAdvance;
+      dev->cursor_x  = 0;
+      dev->cursor_y += size * dev->gfxFont->yAdvance;
     } else if(c != '\r') {
-      uint8 first = _gfxFont->first;
-      if((c >= first) && (c <= _gfxFont->last)) {
-        uint8   c2    = c - _gfxFont->first;
-        GFXglyph *glyph = &(_gfxFont->glyph[c2]);
+      GFXglyph *glyph = _fontGlyph(dev, c);
+      if(glyph) {
         uint8   w     = glyph->width,
                 h     = glyph->height;
+        int     drawn = 0;
         if((w > 0) && (h > 0)) { // Is there an associated bitmap?
           int16 xo = glyph->xOffset;
-          if(_wrap && ((_cursor_x + _textsize * (xo + w)) >= _width)) {
+          if(dev->wrap && ((dev->cursor_x + size * (xo + w)) >= dev->width)) {
             // Drawing character would go off right edge; wrap to new line
-            _cursor_x  = 0;
-            _cursor_y += (int16)_textsize * _gfxFont->yAdvance;
+            dev->cursor_x  = 0;
+            dev->cursor_y += size * dev->gfxFont->yAdvance;
           }
-          SSD1306_drawChar(_cursor_x, _cursor_y, c, _textcolor, _textbgcolor, _textsize);
+          pos->x = dev->cursor_x;
+          pos->y = dev->cursor_y;
+          pos->c = c;
+
+          int16 gx = pos->x + glyph->xOffset * size;
+          int16 gy = pos->y + glyph->yOffset * size;
+          drawn = !((gx >= dev->width) || (gy >= dev->height) ||
+                    ((gx + w * size) <= 0) || ((gy + h * size) <= 0));
         }
-        _cursor_x += glyph->xAdvance * (int16)_textsize;
+        dev->cursor_x += glyph->xAdvance * size;
+        return drawn;
       }
     }
   }
 
+  return 0;
+}
+
+size_t SSD1306_dev_write(SSD1306_t *dev, uint8 c) {
+  glyphPos_t pos;
+  uint16 cp;
+
+  if (dev->term) {
+    _terminalWrite(dev, c);
+    return 1;
+  }
+
+  if (_decodeChar(dev, c, &cp) && _layoutChar(dev, cp, &pos)) {
+    if (dev->gfxFont) {
+      _drawFontGlyph(dev, pos.x, pos.y, dev->gfxFont->bitmap, _fontGlyph(dev, cp),
+                     _colorRop(dev->textcolor), dev->textsize);
+    } else {
+      SSD1306_dev_drawChar(dev, pos.x, pos.y, pos.c, dev->textcolor, dev->textbgcolor, dev->textsize);
+    }
+  }
+
   return 1;
 }
 
-// Draw a character
-void SSD1306_drawChar(int16 x, int16 y, unsigned char c,
+// A classic font glyph as raw column bytes for the current rotation,
+// leftmost raw column first, bit 0 at the top.  Unrotated glyphs come
+// straight from the font; rotated ones are transposed into buf (8 bytes),
+// or once into the glyph cache when there is one.
+static const uint8 *_classicGlyph(SSD1306_t *dev, unsigned char c, uint8 *buf)
+{
+  const uint8 *font = &default_font[c * 5];
+
+  if (dev->rotation == 0) {
+    memcpy(buf, font, 5);
+    buf[5] = 0x00;
+    return buf;
+  }
+
+#if SSD1306_GLYPH_CACHE_SIZE
+  SSD1306_glyphCache_t *entry = &dev->glyph_cache[c % SSD1306_GLYPH_CACHE_SIZE];
+  uint8 *cols = entry->cols;
+  if (entry->c == c && entry->rotation == dev->rotation) {
+    return cols;
+  }
+#else
+  uint8 *cols = buf;
+#endif
+
+  memset(cols, 0, 8);
+  for (uint8 i = 0; i < 5; i++) {
+    for (uint8 j = 0; j < 8; j++) {
+      if (!(font[i] & (1 << j))) {
+        continue;
+      }
+      switch (dev->rotation) {
+        case 1:
+          cols[7 - j] |= (1 << i);
+          break;
+        case 2:
+          cols[5 - i] |= (0x80 >> j);
+          break;
+        case 3:
+          cols[j] |= (1 << (5 - i));
+          break;
+      }
+    }
+  }
+
+#if SSD1306_GLYPH_CACHE_SIZE
+  entry->c = c;
+  entry->rotation = dev->rotation;
+#endif
+  return cols;
+}
+
+// Each nibble stretched to 2, 3 and 4 bits per bit, for scaled text
+static const uint16 _stretch[3][16] = {
+  { 0x0000, 0x0003, 0x000C, 0x000F, 0x0030, 0x0033, 0x003C, 0x003F,
+    0x00C0, 0x00C3, 0x00CC, 0x00CF, 0x00F0, 0x00F3, 0x00FC, 0x00FF },
+  { 0x0000, 0x0007, 0x0038, 0x003F, 0x01C0, 0x01C7, 0x01F8, 0x01FF,
+    0x0E00, 0x0E07, 0x0E38, 0x0E3F, 0x0FC0, 0x0FC7, 0x0FF8, 0x0FFF },
+  { 0x0000, 0x000F, 0x00F0, 0x00FF, 0x0F00, 0x0F0F, 0x0FF0, 0x0FFF,
+    0xF000, 0xF00F, 0xF0F0, 0xF0FF, 0xFF00, 0xFF0F, 0xFFF0, 0xFFFF },
+};
+
+#define SSD1306_MAX_STRETCH (NELEMS(_stretch) + 1)
+
+static uint32 _stretchByte(uint8 b, uint8 scale)
+{
+  if (scale == 1) {
+    return b;
+  }
+
+  const uint16 *tab = _stretch[scale - 2];
+  return tab[b & 0x0F] | ((uint32)tab[b >> 4] << (4 * scale));
+}
+
+// Merge raw glyph columns, scaled up by 1 to SSD1306_MAX_STRETCH, into the
+// cache, clipped to the raw rectangle clip.  Each column is stretched once,
+// then written page by page as a run of scale identical bytes.  Set bits
+// take the foreground op while the rest of the glyph cell takes the
+// background op, in a single read-modify-write.
+static void _blitGlyph(SSD1306_t *dev, int16 rx, int16 ry, const uint8 *cols,
+                       uint8 ncols, uint8 height, uint8 scale,
+                       const rop_t *fg, const rop_t *bg, const SSD1306_rect_t *clip)
+{
+  int16 xs = max(rx, clip->x);
+  int16 xe = min(rx + ncols * scale, clip->x + (int16)clip->w);
+  int16 ys = max(ry, clip->y);
+  int16 ye = min(ry + height * scale, clip->y + (int16)clip->h);
+  if (xs >= xe || ys >= ye) {
+    return;
+  }
+  int16 p0 = ys >> 3;
+  int16 p1 = (ye - 1) >> 3;
+
+  uint32 cell = _stretchByte(0xFF >> (8 - height), scale);
+  uint32 bits[8];
+  for (uint8 k = 0; k < ncols; k++) {
+    bits[k] = _stretchByte(cols[k], scale);
+  }
+
+  for (int16 page = p0; page <= p1; page++) {
+    // Bit of the stretched column that lands on the top row of this page
+    int16 off = page * 8 - ry;
+    uint8 cm = (off >= 0) ? (cell >> off) : (cell << -off);
+    if (page == p0) {
+      cm &= 0xFF << (ys & 0x07);
+    }
+    if (page == p1) {
+      cm &= 0xFF >> (7 - ((ye - 1) & 0x07));
+    }
+    uint8 *addr = &dev->draw_cache[xs + page * SSD1306_LCDWIDTH];
+    uint8 k = (xs - rx) / scale;
+    uint8 run = scale - (xs - rx) % scale;
+
+    for (int16 x = xs; x < xe; k++, run = scale) {
+      uint8 f = cm & ((off >= 0) ? (bits[k] >> off) : (bits[k] << -off));
+      uint8 b = cm & ~f;
+      uint8 clr = (f & fg->clr) | (b & bg->clr);
+      uint8 flip = (f & fg->flip) | (b & bg->flip);
+
+      for (; run && x < xe; run--, x++, addr++) {
+        *addr = (*addr & ~clr) ^ flip;
+      }
+    }
+    _markDirty(dev, page, xs, xe - 1);
+  }
+}
+
+// Classic font character at size 1 to SSD1306_MAX_STRETCH, in any rotation
+static void _drawClassicGlyph(SSD1306_t *dev, int16 x, int16 y, unsigned char c,
+                              const rop_t *fg, const rop_t *bg, uint8 size)
+{
+  uint8 buf[8];
+  const uint8 *cols = _classicGlyph(dev, c, buf);
+
+  // Raw bounding box of the 6x8 cell
+  int16 x0 = _rawX(dev, x, y);
+  int16 y0 = _rawY(dev, x, y);
+  int16 x1 = _rawX(dev, x + 6 * size - 1, y + 8 * size - 1);
+  int16 y1 = _rawY(dev, x + 6 * size - 1, y + 8 * size - 1);
+
+  // Raw extent of the logical width and height, which a text widget
+  // narrows to clip its text
+  int16 vx0 = _rawX(dev, 0, 0);
+  int16 vy0 = _rawY(dev, 0, 0);
+  int16 vx1 = _rawX(dev, dev->width - 1, dev->height - 1);
+  int16 vy1 = _rawY(dev, dev->width - 1, dev->height - 1);
+  SSD1306_rect_t clip = {
+    min(vx0, vx1), min(vy0, vy1), _abs(vx1 - vx0) + 1, _abs(vy1 - vy0) + 1,
+  };
+
+  _blitGlyph(dev, min(x0, x1), min(y0, y1), cols,
+             (dev->rotation & 1) ? 8 : 6, (dev->rotation & 1) ? 6 : 8, size,
+             fg, bg, &clip);
+}
+
+// Ops for classic text, with &_ropNone standing in for an invalid color
+// or a background matching the foreground
+static void _textRops(uint16 color, uint16 bg, const rop_t **fgrop, const rop_t **bgrop)
+{
+  *fgrop = _colorRop(color);
+  *bgrop = (bg != color) ? _colorRop(bg) : NULL;
+  if (!*fgrop) {
+    *fgrop = &_ropNone;
+  }
+  if (!*bgrop) {
+    *bgrop = &_ropNone;
+  }
+}
+
+// A run of set bits in a GFXfont glyph, grown downwards while the rows
+// below repeat it exactly.  In glyph cells.
+typedef struct {
+  uint8 x;
+  uint8 w;
+  uint8 y;
+  uint8 h;
+} glyphRun_t;
+
+// Runs kept open from one glyph row to the next; any more are drawn as
+// they are found.
+#define SSD1306_GLYPH_RUNS 16
+
+static void _drawGlyphRun(SSD1306_t *dev, int16 lx, int16 ly, glyphRun_t *run,
+                          uint8 size, const rop_t *rop)
+{
+  _fillRectRotated(dev, lx + run->x * size, ly + run->y * size,
+                   run->w * size, run->h * size, rop);
+}
+
+// GFXfont glyph.  The glyph is clipped to the screen in whole cells before
+// its bitmap is read, then each row is decoded into runs of set bits.  Runs
+// repeated on following rows become one rectangle, so stems and bars of
+// large fonts are filled a page at a time by the span kernel.
+static void _drawFontGlyph(SSD1306_t *dev, int16 x, int16 y, uint8 *bitmap,
+                           GFXglyph *glyph, const rop_t *rop, uint8 size)
+{
+  if (!rop || !size) {
+    return;
+  }
+
+  uint8 w = glyph->width;
+  uint8 h = glyph->height;
+
+  // Top left corner of the glyph's cell grid
+  int16 lx = x + glyph->xOffset * size;
+  int16 ly = y + glyph->yOffset * size;
+
+  if (!w || !h || lx >= dev->width || ly >= dev->height ||
+      (lx + w * size) <= 0 || (ly + h * size) <= 0) {
+    return;
+  }
+
+  // Visible cells
+  uint8 cx0 = (lx < 0) ? (-lx / size) : 0;
+  uint8 cy0 = (ly < 0) ? (-ly / size) : 0;
+  uint8 cx1 = min(w, (dev->width - lx + size - 1) / size);
+  uint8 cy1 = min(h, (dev->height - ly + size - 1) / size);
+
+  glyphRun_t open[SSD1306_GLYPH_RUNS];
+  glyphRun_t next[SSD1306_GLYPH_RUNS];
+  uint8 nopen = 0;
+  uint8 nnext;
+
+  bitmap += glyph->bitmapOffset;
+
+  for (uint8 yy = cy0; yy < cy1; yy++) {
+    uint16 bit = (uint16)yy * w + cx0;
+    uint8 j = 0;
+    nnext = 0;
+
+    for (uint8 xx = cx0; xx < cx1; ) {
+      if (!(bitmap[bit >> 3] & (0x80 >> (bit & 7)))) {
+        xx++;
+        bit++;
+        continue;
+      }
+
+      glyphRun_t run = { xx, 0, yy, 1 };
+      for (; xx < cx1 && (bitmap[bit >> 3] & (0x80 >> (bit & 7))); xx++, bit++) {
+        run.w++;
+      }
+
+      // Close the open runs to the left of this one
+      for (; j < nopen && open[j].x < run.x; j++) {
+        _drawGlyphRun(dev, lx, ly, &open[j], size, rop);
+      }
+      if (j < nopen && open[j].x == run.x && open[j].w == run.w) {
+        run = open[j++];
+        run.h++;
+      }
+
+      if (nnext < SSD1306_GLYPH_RUNS) {
+        next[nnext++] = run;
+      } else {
+        _drawGlyphRun(dev, lx, ly, &run, size, rop);
+      }
+    }
+
+    for (; j < nopen; j++) {
+      _drawGlyphRun(dev, lx, ly, &open[j], size, rop);
+    }
+    memcpy(open, next, nnext * sizeof(glyphRun_t));
+    nopen = nnext;
+  }
+
+  for (uint8 j = 0; j < nopen; j++) {
+    _drawGlyphRun(dev, lx, ly, &open[j], size, rop);
+  }
+}
+
+// Draw a character.  cp is a code point with a GFXfontEx set; the classic
+// font only has 0x00 to 0xFF.
+void SSD1306_dev_drawChar(SSD1306_t *dev, int16 x, int16 y, uint16 cp,
  uint16 color, uint16 bg, uint8 size) {
 
-  if(!_gfxFont) { // 'Classic' built-in font
+  if(!dev->gfxFont) { // 'Classic' built-in font
 
-    if((x >= _width)            || // Clip right
-       (y >= _height)           || // Clip bottom
+    if((cp > 0xFF)                  || // Not in the font
+       (x >= dev->width)            || // Clip right
+       (y >= dev->height)           || // Clip bottom
        ((x + 6 * size - 1) < 0) || // Clip left
        ((y + 8 * size - 1) < 0))   // Clip top
       return;
 
-    if(!_cp437 && (c >= 176)) c++; // Handle 'classic' charset behavior
+    unsigned char c = cp;
+    if(!dev->cp437 && (c >= 176)) c++; // Handle 'classic' charset behavior
+
+    if(size >= 1 && size <= SSD1306_MAX_STRETCH) {
+      const rop_t *fgrop, *bgrop;
+      _textRops(color, bg, &fgrop, &bgrop);
+      _drawClassicGlyph(dev, x, y, c, fgrop, bgrop, size);
+      return;
+    }
 
     for(int8 i=0; i<6; i++ ) {
       uint8 line;
@@ -987,11 +3154,11 @@ void SSD1306_drawChar(int16 x, int16 y, unsigned char c,
       else      line = 0x0;
       for(int8 j=0; j<8; j++, line >>= 1) {
         if(line & 0x1) {
-          if(size == 1) SSD1306_drawPixel(x+i, y+j, color);
-          else          SSD1306_fillRect(x+(i*size), y+(j*size), size, size, color);
+          if(size == 1) SSD1306_dev_drawPixel(dev, x+i, y+j, color);
+          else          SSD1306_dev_fillRect(dev, x+(i*size), y+(j*size), size, size, color);
         } else if(bg != color) {
-          if(size == 1) SSD1306_drawPixel(x+i, y+j, bg);
-          else          SSD1306_fillRect(x+i*size, y+j*size, size, size, bg);
+          if(size == 1) SSD1306_dev_drawPixel(dev, x+i, y+j, bg);
+          else          SSD1306_dev_fillRect(dev, x+i*size, y+j*size, size, size, bg);
         }
       }
     }
@@ -1002,27 +3169,12 @@ void SSD1306_drawChar(int16 x, int16 y, unsigned char c,
     // newlines, returns, non-printable characters, etc.  Calling drawChar()
     // directly with 'bad' characters of font may cause mayhem!
 
-    c -= _gfxFont->first;
-    GFXglyph *glyph  = &(_gfxFont->glyph[c]);
-    uint8  *bitmap = _gfxFont->bitmap;
+    GFXglyph *glyph = _fontGlyph(dev, cp);
 
-    uint16 bo = glyph->bitmapOffset;
-    uint8  w  = glyph->width,
-           h  = glyph->height;
-    
-    //uint8 xa = glyph->xAdvance;
-    int8   xo = glyph->xOffset,
-           yo = glyph->yOffset;
-    uint8  xx, yy, bits = 0, bit = 0;
-    int16  xo16 = 0, yo16 = 0;
-
-    if(size > 1) {
-      xo16 = xo;
-      yo16 = yo;
+    if (glyph) {
+      _drawFontGlyph(dev, x, y, dev->gfxFont->bitmap, glyph, _colorRop(color), size);
     }
 
-    // Todo: Add character clipping here
-
     // NOTE: THERE IS NO 'BACKGROUND' COLOR OPTION ON CUSTOM FONTS.
     // THIS IS ON PURPOSE AND BY DESIGN.  The background color feature
     // has typically been used with the 'classic' font to overwrite old
@@ -1039,69 +3191,352 @@ void SSD1306_drawChar(int16 x, int16 y, unsigned char c,
     // displays supporting setAddrWindow() and pushColors()), but haven't
     // implemented this yet.
 
-    for(yy=0; yy<h; yy++) {
-      for(xx=0; xx<w; xx++) {
-        if(!(bit++ & 7)) {
-          bits = bitmap[bo++];
-        }
-        if(bits & 0x80) {
-          if(size == 1) {
-            SSD1306_drawPixel(x+xo+xx, y+yo+yy, color);
-          } else {
-            SSD1306_fillRect(x+(xo16+xx)*size, y+(yo16+yy)*size, size, size, color);
-          }
-        }
-        bits <<= 1;
+  } // End classic vs custom font
+}
+
+// Grow r to cover a rectangle, clipped to the screen
+static void _rectUnion(SSD1306_t *dev, SSD1306_rect_t *r, int16 x, int16 y, int16 w, int16 h)
+{
+  int16 x1 = min(x + w, dev->width);
+  int16 y1 = min(y + h, dev->height);
+  x = max(x, 0);
+  y = max(y, 0);
+  if (x >= x1 || y >= y1) {
+    return;
+  }
+
+  if (r->w && r->h) {
+    x1 = max(x1, r->x + (int16)r->w);
+    y1 = max(y1, r->y + (int16)r->h);
+    x = min(x, r->x);
+    y = min(y, r->y);
+  }
+  r->x = x;
+  r->y = y;
+  r->w = x1 - x;
+  r->h = y1 - y;
+}
+
+// Draw a batch of laid out glyphs with the text colors already resolved
+static void _drawGlyphs(SSD1306_t *dev, glyphPos_t *batch, uint8 count, SSD1306_rect_t *bounds)
+{
+  uint8 size = dev->textsize;
+  const rop_t *fgrop, *bgrop;
+
+  _textRops(dev->textcolor, dev->textbgcolor, &fgrop, &bgrop);
+
+  for (uint8 i = 0; i < count; i++) {
+    glyphPos_t *pos = &batch[i];
+
+    if(!dev->gfxFont) { // 'Classic' built-in font
+      unsigned char c = pos->c;
+      if(!dev->cp437 && (c >= 176)) c++; // Handle 'classic' charset behavior
+
+      if(size >= 1 && size <= SSD1306_MAX_STRETCH) {
+        _drawClassicGlyph(dev, pos->x, pos->y, c, fgrop, bgrop, size);
+      } else {
+        SSD1306_dev_drawChar(dev, pos->x, pos->y, pos->c, dev->textcolor, dev->textbgcolor, size);
       }
+      _rectUnion(dev, bounds, pos->x, pos->y, 6 * size, 8 * size);
+    } else { // Custom font
+      GFXglyph *glyph = _fontGlyph(dev, pos->c);
+
+      _drawFontGlyph(dev, pos->x, pos->y, dev->gfxFont->bitmap, glyph,
+                     _colorRop(dev->textcolor), size);
+      _rectUnion(dev, bounds, pos->x + glyph->xOffset * size,
+                 pos->y + glyph->yOffset * size,
+                 glyph->width * size, glyph->height * size);
     }
+  }
+}
 
-  } // End classic vs custom font
+// A string being laid out and drawn SSD1306_TEXT_BATCH glyphs at a time
+typedef struct {
+  glyphPos_t batch[SSD1306_TEXT_BATCH];
+  uint8 count;
+  SSD1306_rect_t bounds;
+} textRun_t;
+
+static void _runBegin(textRun_t *run) {
+  run->count = 0;
+  run->bounds.x = 0;
+  run->bounds.y = 0;
+  run->bounds.w = 0;
+  run->bounds.h = 0;
+}
+
+static void _runPut(SSD1306_t *dev, textRun_t *run, uint8 c) {
+  uint16 cp;
+
+  if (dev->term) {
+    _terminalWrite(dev, c);
+    return;
+  }
+
+  if (_decodeChar(dev, c, &cp) &&
+      _layoutChar(dev, cp, &run->batch[run->count]) &&
+      ++run->count == SSD1306_TEXT_BATCH) {
+    _drawGlyphs(dev, run->batch, run->count, &run->bounds);
+    run->count = 0;
+  }
+}
+
+static void _runPad(SSD1306_t *dev, textRun_t *run, char pad, int16 count) {
+  for (; count > 0; count--) {
+    _runPut(dev, run, pad);
+  }
+}
+
+static SSD1306_rect_t _runEnd(SSD1306_t *dev, textRun_t *run) {
+  _drawGlyphs(dev, run->batch, run->count, &run->bounds);
+  return run->bounds;
+}
+
+// Write len characters at the cursor.  The string is laid out with the
+// same wrapping and newline handling as SSD1306_write(); glyphs that land
+// off screen are dropped there, and the rest are drawn in batches.
+// Returns the area drawn, clipped to the screen.
+SSD1306_rect_t SSD1306_dev_print(SSD1306_t *dev, const char *str, size_t len) {
+  textRun_t run;
+
+  _runBegin(&run);
+  for (; len; len--, str++) {
+    _runPut(dev, &run, (uint8)*str);
+  }
+
+  return _runEnd(dev, &run);
+}
+
+SSD1306_rect_t SSD1306_dev_printAt(SSD1306_t *dev, int16 x, int16 y, const char *str, size_t len) {
+  SSD1306_dev_setCursor(dev, x, y);
+  return SSD1306_dev_print(dev, str, len);
+}
+
+static const uint32 _pow10[] = {
+  1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL, 1000000UL, 10000000UL,
+  100000000UL, 1000000000UL,
+};
+
+// Decimal digits needed for v
+static uint8 _decDigits(uint32 v) {
+  uint8 n = 1;
+  while (n < NELEMS(_pow10) && v >= _pow10[n]) {
+    n++;
+  }
+  return n;
+}
+
+// Write a signed decimal straight into a text run: ndigits digits of
+// mag, most significant first, with a decimal point before the last
+// decimals of them, right-aligned in width characters.  Padding with '0'
+// goes after the sign, anything else before it.  Digits come from repeated
+// subtraction of powers of ten, so there is no division.
+static void _putDecimal(SSD1306_t *dev, textRun_t *run, uint8 neg, uint32 mag,
+                        uint8 decimals, uint8 width, char pad) {
+  uint8 ndigits = max(_decDigits(mag), decimals + 1);
+  int16 padding = width - (neg + ndigits + (decimals ? 1 : 0));
+
+  if (pad != '0') {
+    _runPad(dev, run, pad, padding);
+  }
+  if (neg) {
+    _runPut(dev, run, '-');
+  }
+  if (pad == '0') {
+    _runPad(dev, run, pad, padding);
+  }
+
+  while (ndigits--) {
+    char d = '0';
+
+    while (mag >= _pow10[ndigits]) {
+      mag -= _pow10[ndigits];
+      d++;
+    }
+    _runPut(dev, run, d);
+    if (decimals && ndigits == decimals) {
+      _runPut(dev, run, '.');
+    }
+  }
+}
+
+// Print an integer at the cursor, right-aligned in width characters
+// (0 for no padding)
+SSD1306_rect_t SSD1306_dev_printInt(SSD1306_t *dev, int32 value, uint8 width, char pad) {
+  return SSD1306_dev_printFixed(dev, value, 0, width, pad);
+}
+
+// Print value / 10^decimals, e.g. 1234 with 2 decimals as "12.34"
+SSD1306_rect_t SSD1306_dev_printFixed(SSD1306_t *dev, int32 value, uint8 decimals,
+                                      uint8 width, char pad) {
+  textRun_t run;
+  uint8 neg = (value < 0);
+  uint32 mag = neg ? (0UL - (uint32)value) : (uint32)value;
+
+  _runBegin(&run);
+  _putDecimal(dev, &run, neg, mag, min(decimals, NELEMS(_pow10) - 1), width, pad);
+  return _runEnd(dev, &run);
+}
+
+// Print value as upper case hex, right-aligned in width characters
+SSD1306_rect_t SSD1306_dev_printHex(SSD1306_t *dev, uint32 value, uint8 width, char pad) {
+  textRun_t run;
+  uint8 ndigits = 1;
+
+  while (ndigits < 8 && (value >> (4 * ndigits))) {
+    ndigits++;
+  }
+
+  _runBegin(&run);
+  _runPad(dev, &run, pad, width - ndigits);
+  while (ndigits--) {
+    uint8 nibble = (value >> (4 * ndigits)) & 0x0F;
+    _runPut(dev, &run, (nibble < 10) ? ('0' + nibble) : ('A' + nibble - 10));
+  }
+  return _runEnd(dev, &run);
+}
+
+// Terminal mode.  Text rows are pages, and scrolling moves the panel's
+// display start line down one page instead of moving pixels: the cache is
+// kept in GDDRAM order, with text row r in page (r + start_page) % pages.
+// A new line only clears and resends the one page it exposes.  A text
+// row is one page tall, so only the classic font at size 1, always
+// wrapping, fits it; the text settings are put to that here so they say
+// what write() does.
+void SSD1306_dev_terminalBegin(SSD1306_t *dev) {
+  SSD1306_dev_setFont(dev, NULL);
+  SSD1306_dev_setTextSize(dev, 1);
+  SSD1306_dev_setTextWrap(dev, 1);
+  SSD1306_dev_setTextColor(dev, WHITE, BLACK);
+  SSD1306_dev_setRotation(dev, 0);
+  SSD1306_dev_clearDisplay(dev);
+  dev->cursor_x = 0;
+  dev->cursor_y = 0;
+  dev->start_page = 0;
+  dev->term = 1;
+}
+
+// Leave terminal mode, putting the rows back in order so normal drawing
+// and a start line of 0 apply again
+void SSD1306_dev_terminalEnd(SSD1306_t *dev) {
+  uint8 pages = _pages(dev);
+  uint8 row[SSD1306_LCDWIDTH];
+
+  for (; dev->start_page; dev->start_page--) {
+    memcpy(row, dev->draw_cache, SSD1306_LCDWIDTH);
+    memmove(dev->draw_cache, &dev->draw_cache[SSD1306_LCDWIDTH],
+            (pages - 1) * SSD1306_LCDWIDTH);
+    memcpy(&dev->draw_cache[(pages - 1) * SSD1306_LCDWIDTH], row, SSD1306_LCDWIDTH);
+  }
+
+  dev->term = 0;
+  dev->cursor_y = (dev->cursor_y >> 3) << 3;
+  SSD1306_dev_markDirty(dev);
+}
+
+static void _terminalNewline(SSD1306_t *dev) {
+  uint8 pages = _pages(dev);
+
+  dev->cursor_x = 0;
+  if ((dev->cursor_y >> 3) + 1 < pages) {
+    dev->cursor_y += 8;
+    return;
+  }
+
+  // Scroll: the old top page becomes the new, blank, bottom row
+  uint8 page = dev->start_page;
+  dev->start_page = (dev->start_page + 1) % pages;
+  memset(&dev->draw_cache[page * SSD1306_LCDWIDTH], 0, dev->WIDTH);
+  _markDirty(dev, page, 0, dev->WIDTH - 1);
+}
+
+static void _terminalWrite(SSD1306_t *dev, uint8 c) {
+  if (c == '\n') {
+    _terminalNewline(dev);
+    return;
+  }
+  if (c == '\r') {
+    dev->cursor_x = 0;
+    return;
+  }
+
+  if (dev->cursor_x + 6 > dev->WIDTH) {
+    _terminalNewline(dev);
+  }
+
+  const rop_t *fgrop, *bgrop;
+  uint8 page = ((dev->cursor_y >> 3) + dev->start_page) % _pages(dev);
+
+  if (!dev->cp437 && (c >= 176)) c++; // Handle 'classic' charset behavior
+  _textRops(dev->textcolor, dev->textbgcolor, &fgrop, &bgrop);
+  _drawClassicGlyph(dev, dev->cursor_x, page << 3, c, fgrop, bgrop, 1);
+  dev->cursor_x += 6;
 }
 
-void SSD1306_setCursor(int16 x, int16 y) {
-  _cursor_x = x;
-  _cursor_y = y;
+void SSD1306_dev_setCursor(SSD1306_t *dev, int16 x, int16 y) {
+  dev->cursor_x = x;
+  dev->cursor_y = y;
 }
 
-int16 SSD1306_getCursorX(void) {
-  return _cursor_x;
+int16 SSD1306_dev_getCursorX(SSD1306_t *dev) {
+  return dev->cursor_x;
 }
 
-int16 SSD1306_getCursorY(void) {
-  return _cursor_y;
+int16 SSD1306_dev_getCursorY(SSD1306_t *dev) {
+  return dev->cursor_y;
 }
 
-void SSD1306_setTextSize(uint8 s) {
-  _textsize = (s > 0) ? s : 1;
+void SSD1306_dev_setTextSize(SSD1306_t *dev, uint8 s) {
+  dev->textsize = (s > 0) ? s : 1;
 }
 
-void SSD1306_setTextColor(uint16 c, uint16 b) {
+void SSD1306_dev_setTextColor(SSD1306_t *dev, uint16 c, uint16 b) {
   // For 'transparent' background, we'll set the bg
   // to the same as fg instead of using a flag
-  _textcolor   = c;
-  _textbgcolor = b;
+  dev->textcolor   = c;
+  dev->textbgcolor = b;
+}
+
+void SSD1306_dev_setTextWrap(SSD1306_t *dev, int w) {
+  dev->wrap = w;
 }
 
-void SSD1306_setTextWrap(int w) {
-  _wrap = w;
+uint8 SSD1306_dev_getRotation(SSD1306_t *dev) {
+  return dev->rotation;
 }
 
-uint8 SSD1306_getRotation(void) {
-  return _rotation;
+static void _setTransform(SSD1306_t *dev, int16 x0, int8 xx, int8 xy,
+                          int16 y0, int8 yx, int8 yy) {
+  dev->rot_x0 = x0;
+  dev->rot_xx = xx;
+  dev->rot_xy = xy;
+  dev->rot_y0 = y0;
+  dev->rot_yx = yx;
+  dev->rot_yy = yy;
 }
 
-void SSD1306_setRotation(uint8 x) {
-  _rotation = (x & 3);
-  switch(_rotation) {
+void SSD1306_dev_setRotation(SSD1306_t *dev, uint8 x) {
+  dev->rotation = (x & 3);
+  switch(dev->rotation) {
    case 0:
-   case 2:
-    _width  = _WIDTH;
-    _height = _HEIGHT;
+    dev->width  = dev->WIDTH;
+    dev->height = dev->HEIGHT;
+    _setTransform(dev, 0, 1, 0, 0, 0, 1);
     break;
    case 1:
+    dev->width  = dev->HEIGHT;
+    dev->height = dev->WIDTH;
+    _setTransform(dev, dev->WIDTH - 1, 0, -1, 0, 1, 0);
+    break;
+   case 2:
+    dev->width  = dev->WIDTH;
+    dev->height = dev->HEIGHT;
+    _setTransform(dev, dev->WIDTH - 1, -1, 0, dev->HEIGHT - 1, 0, -1);
+    break;
    case 3:
-    _width  = _HEIGHT;
-    _height = _WIDTH;
+    dev->width  = dev->HEIGHT;
+    dev->height = dev->WIDTH;
+    _setTransform(dev, 0, 0, 1, dev->HEIGHT - 1, -1, 0);
     break;
   }
 }
@@ -1113,27 +3548,34 @@ void SSD1306_setRotation(uint8 x) {
 // with the erroneous character indices.  By default, the library uses the
 // original 'wrong' behavior and old sketches will still work.  Pass 'true'
 // to this function to use correct CP437 character values in your code.
-void SSD1306_cp437(int x) {
-  _cp437 = x;
+void SSD1306_dev_cp437(SSD1306_t *dev, int x) {
+  dev->cp437 = x;
 }
 
-void SSD1306_setFont(const GFXfont *f) {
+void SSD1306_dev_setFont(SSD1306_t *dev, const GFXfont *f) {
   if(f) {          // Font struct pointer passed in?
-    if(!_gfxFont) { // And no current font struct?
+    if(!dev->gfxFont) { // And no current font struct?
       // Switching from classic to new font behavior.
       // Move cursor pos down 6 pixels so it's on baseline.
-      _cursor_y += 6;
+      dev->cursor_y += 6;
     }
-  } else if(_gfxFont) { // NULL passed.  Current font struct defined?
+  } else if(dev->gfxFont) { // NULL passed.  Current font struct defined?
     // Switching from new to classic font behavior.
     // Move cursor pos up 6 pixels so it's at top-left of char.
-    _cursor_y -= 6;
+    dev->cursor_y -= 6;
   }
-  _gfxFont = (GFXfont *)f;
+  dev->gfxFont = (GFXfont *)f;
+  dev->gfxFontEx = NULL;
+  dev->utf8_pending = 0;
+}
+
+void SSD1306_dev_setFontEx(SSD1306_t *dev, const GFXfontEx *f) {
+  SSD1306_dev_setFont(dev, f ? &f->font : NULL);
+  dev->gfxFontEx = f;
 }
 
 // Pass string and a cursor position, returns UL corner and W,H.
-void SSD1306_getTextBounds(char *str, int16 x, int16 y,
+static void _measureText(SSD1306_t *dev, const char *str, int16 x, int16 y,
  int16 *x1, int16 *y1, uint16 *w, uint16 *h) {
   uint8 c; // Current character
 
@@ -1141,29 +3583,32 @@ void SSD1306_getTextBounds(char *str, int16 x, int16 y,
   *y1 = y;
   *w  = *h = 0;
 
-  if(_gfxFont) {
+  if(dev->gfxFont) {
 
     GFXglyph *glyph;
-    uint8   first = _gfxFont->first,
-            last  = _gfxFont->last,
-            gw, gh, xa;
+    uint8   gw, gh, xa;
     int8    xo, yo;
-    int16   minx = _width, miny = _height, maxx = -1, maxy = -1,
-              gx1, gy1, gx2, gy2, ts = (int16)_textsize,
-              ya = ts * _gfxFont->yAdvance;
+    int16   minx = dev->width, miny = dev->height, maxx = -1, maxy = -1,
+              gx1, gy1, gx2, gy2, ts = (int16)dev->textsize,
+              ya = ts * dev->gfxFont->yAdvance;
+    uint16  cp, acc = 0;
+    uint8   pending = 0;
 
     while((c = *str++)) {
-      if(c != '\n') { // Not a newline
-        if(c != '\r') { // Not a carriage return, is normal char
-          if((c >= first) && (c <= last)) { // Char present in current font
-            c    -= first;
-            glyph = &(_gfxFont->glyph[c]);
+      if(dev->gfxFontEx) {
+        if(!_utf8Decode(&acc, &pending, c, &cp)) continue;
+      } else {
+        cp = c;
+      }
+      if(cp != '\n') { // Not a newline
+        if(cp != '\r') { // Not a carriage return, is normal char
+          if((glyph = _fontGlyph(dev, cp))) { // Char present in current font
             gw    = glyph->width;
             gh    = glyph->height;
             xa    = glyph->xAdvance;
             xo    = glyph->xOffset;
             yo    = glyph->yOffset;
-            if(_wrap && ((x + (((int16)xo + gw) * ts)) >= _width)) {
+            if(dev->wrap && ((x + (((int16)xo + gw) * ts)) >= dev->width)) {
               // Line wrap
               x  = 0;  // Reset x to 0
               y += ya; // Advance y by 1 line
@@ -1197,24 +3642,24 @@ void SSD1306_getTextBounds(char *str, int16 x, int16 y,
     while((c = *str++)) {
       if(c != '\n') { // Not a newline
         if(c != '\r') { // Not a carriage return, is normal char
-          if(_wrap && ((x + _textsize * 6) >= _width)) {
+          if(dev->wrap && ((x + dev->textsize * 6) >= dev->width)) {
             x  = 0;            // Reset x to 0
-            y += _textsize * 8; // Advance y by 1 line
+            y += dev->textsize * 8; // Advance y by 1 line
             if(lineWidth > maxWidth) maxWidth = lineWidth; // Save widest line
-            lineWidth  = _textsize * 6; // First char on new line
+            lineWidth  = dev->textsize * 6; // First char on new line
           } else { // No line wrap, just keep incrementing X
-            lineWidth += _textsize * 6; // Includes interchar x gap
+            lineWidth += dev->textsize * 6; // Includes interchar x gap
           }
         } // Carriage return = do nothing
       } else { // Newline
         x  = 0;            // Reset x to 0
-        y += _textsize * 8; // Advance y by 1 line
+        y += dev->textsize * 8; // Advance y by 1 line
         if(lineWidth > maxWidth) maxWidth = lineWidth; // Save widest line
         lineWidth = 0;     // Reset lineWidth for new line
       }
     }
     // End of string
-    if(lineWidth) y += _textsize * 8; // Add height of last (or only) line
+    if(lineWidth) y += dev->textsize * 8; // Add height of last (or only) line
     if(lineWidth > maxWidth) maxWidth = lineWidth; // Is the last or only line the widest?
     *w = maxWidth - 1;               // Don't include last interchar x gap
     *h = y - *y1;
@@ -1222,13 +3667,158 @@ void SSD1306_getTextBounds(char *str, int16 x, int16 y,
   } // End classic vs custom font
 }
 
+// Pass string and a cursor position, returns UL corner and W,H.  GFXfont
+// results are remembered, so measuring the same label again costs one
+// hashing pass over the string rather than a glyph lookup per character.
+// Classic font characters are all 6 x 8, so measuring those is already
+// no dearer than hashing them and they aren't cached.
+void SSD1306_dev_getTextBounds(SSD1306_t *dev, char *str, int16 x, int16 y,
+ int16 *x1, int16 *y1, uint16 *w, uint16 *h) {
+#if SSD1306_MEASURE_CACHE_SIZE
+  uint32 hash = 2166136261UL;
+  uint16 len = 0;
+  uint8 flags = (dev->wrap ? SSD1306_MEASURE_WRAP : 0) |
+                (dev->gfxFontEx ? SSD1306_MEASURE_UTF8 : 0);
+  SSD1306_measure_t *m;
+
+  if (!dev->gfxFont) {
+    _measureText(dev, str, x, y, x1, y1, w, h);
+    return;
+  }
+
+  for (const char *p = str; *p; p++, len++) {
+    hash = (hash ^ (uint8)*p) * 16777619UL;
+  }
+
+  for (uint8 i = 0; i < SSD1306_MEASURE_CACHE_SIZE; i++) {
+    m = &dev->measure_cache[i];
+    if (m->hash == hash && m->len == len && m->font == dev->gfxFont &&
+        m->x == x && m->y == y && m->width == dev->width &&
+        m->size == dev->textsize && m->flags == flags) {
+      *x1 = m->x1;
+      *y1 = m->y1;
+      *w  = m->w;
+      *h  = m->h;
+      return;
+    }
+  }
+
+  _measureText(dev, str, x, y, x1, y1, w, h);
+
+  m = &dev->measure_cache[dev->measure_next];
+  dev->measure_next = (dev->measure_next + 1) % SSD1306_MEASURE_CACHE_SIZE;
+  m->font  = dev->gfxFont;
+  m->hash  = hash;
+  m->len   = len;
+  m->x     = x;
+  m->y     = y;
+  m->width = dev->width;
+  m->size  = dev->textsize;
+  m->flags = flags;
+  m->x1    = *x1;
+  m->y1    = *y1;
+  m->w     = *w;
+  m->h     = *h;
+#else
+  _measureText(dev, str, x, y, x1, y1, w, h);
+#endif
+}
+
+// Close the line ending before str[end] and start the next at str[next]
+static uint8 _endLine(SSD1306_textLine_t *lines, uint8 count, uint8 maxLines,
+                      uint16 *start, uint16 end, uint16 next,
+                      int16 minx, int16 maxx, int16 x0) {
+  if (count < maxLines) {
+    lines[count].start = *start;
+    lines[count].len   = end - *start;
+    lines[count].x1    = (maxx >= minx) ? (minx - x0) : 0;
+    lines[count].w     = (maxx >= minx) ? (maxx - minx + 1) : 0;
+  }
+  *start = next;
+  return count + 1;
+}
+
+// Split str into lines as SSD1306_write() starting at x would, in one
+// pass, recording each line's extent.  A newline at the very end does not
+// start another line.
+uint8 SSD1306_dev_layoutText(SSD1306_t *dev, const char *str, int16 x,
+ SSD1306_textLine_t *lines, uint8 maxLines) {
+  int16 ts = (int16)dev->textsize;
+  int16 x0 = x;                         // Where the current line starts
+  int16 minx = 0x7FFF, maxx = -0x7FFF;  // Ink on the current line
+  uint16 start = 0, i;
+  uint16 lead = 0;                      // First byte of the character
+  uint8 count = 0;
+  uint16 c, acc = 0;
+  uint8 pending = 0;
+
+  for (i = 0; str[i] && count < maxLines; i++) {
+    if (!pending || ((uint8)str[i] & 0xC0) != 0x80) {
+      lead = i;
+    }
+    if (dev->gfxFontEx) {
+      if (!_utf8Decode(&acc, &pending, str[i], &c)) {
+        continue;
+      }
+    } else {
+      c = (uint8)str[i];
+    }
+
+    if (c == '\n') {
+      count = _endLine(lines, count, maxLines, &start, i, i + 1, minx, maxx, x0);
+      x = x0 = 0;
+      minx = 0x7FFF;
+      maxx = -0x7FFF;
+      continue;
+    }
+    if (c == '\r') {
+      continue;
+    }
+
+    int16 gx1, gw, xa;
+    if (dev->gfxFont) {
+      GFXglyph *glyph = _fontGlyph(dev, c);
+      if (!glyph) {
+        continue;
+      }
+      gx1 = glyph->xOffset * ts;
+      gw  = glyph->width * ts;
+      xa  = glyph->xAdvance * ts;
+    } else {
+      gx1 = 0;
+      gw  = 6 * ts - 1;                 // Don't include the interchar x gap
+      xa  = 6 * ts;
+    }
+
+    if (dev->wrap && ((x + (dev->gfxFont ? gx1 + gw : xa)) >= dev->width)) {
+      count = _endLine(lines, count, maxLines, &start, lead, lead, minx, maxx, x0);
+      x = x0 = 0;
+      minx = 0x7FFF;
+      maxx = -0x7FFF;
+      if (count >= maxLines) {
+        break;
+      }
+    }
+
+    minx = min(minx, x + gx1);
+    maxx = max(maxx, x + gx1 + gw - 1);
+    x += xa;
+  }
+
+  if (count < maxLines && start < i) {
+    count = _endLine(lines, count, maxLines, &start, i, i, minx, maxx, x0);
+  }
+
+  return count;
+}
+
 // Return the size of the display (per current rotation)
-int16 SSD1306_width(void) {
-  return _width;
+int16 SSD1306_dev_width(SSD1306_t *dev) {
+  return dev->width;
 }
 
-int16 SSD1306_height(void) {
-  return _height;
+int16 SSD1306_dev_height(SSD1306_t *dev) {
+  return dev->height;
 }
 
 
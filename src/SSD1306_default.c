@@ -0,0 +1,385 @@
+/*
+ * Default SSD1306 panel, for code that drives a single display through the
+ * original SSD1306_* API.  Each call forwards to the SSD1306_dev_* function
+ * on a statically allocated context.
+ *
+ * released under an MIT License
+ */
+
+#include "project.h"
+#include "SSD1306.h"
+
+#ifndef SSD1306_NO_DEFAULT
+static SSD1306_t _default;
+
+SSD1306_t *SSD1306_getDefault(void) {
+  return &_default;
+}
+
+void SSD1306_initialize(void) {
+  SSD1306_dev_initialize(&_default);
+}
+
+void SSD1306_setAddress(uint8 i2caddr) {
+  SSD1306_dev_setAddress(&_default, i2caddr);
+}
+
+void SSD1306_setVccstate(uint8 vccstate) {
+  SSD1306_dev_setVccstate(&_default, vccstate);
+}
+
+void SSD1306_reset(void) {
+  SSD1306_dev_reset(&_default);
+}
+
+void SSD1306_begin(void) {
+  SSD1306_dev_begin(&_default);
+}
+
+void SSD1306_commandBegin(void) {
+  SSD1306_dev_commandBegin(&_default);
+}
+
+void SSD1306_command(uint8 c) {
+  SSD1306_dev_command(&_default, c);
+}
+
+void SSD1306_commandCommit(void) {
+  SSD1306_dev_commandCommit(&_default);
+}
+
+void SSD1306_displayOff(void) {
+  SSD1306_dev_displayOff(&_default);
+}
+
+void SSD1306_displayOn(void) {
+  SSD1306_dev_displayOn(&_default);
+}
+
+void SSD1306_clearDisplay(void) {
+  SSD1306_dev_clearDisplay(&_default);
+}
+
+void SSD1306_invertDisplay(uint8 i) {
+  SSD1306_dev_invertDisplay(&_default, i);
+}
+
+void SSD1306_display(void) {
+  SSD1306_dev_display(&_default);
+}
+
+void SSD1306_setFlushChunkSize(uint16 size) {
+  SSD1306_dev_setFlushChunkSize(&_default, size);
+}
+
+void SSD1306_displayAsync(void) {
+  SSD1306_dev_displayAsync(&_default);
+}
+
+int SSD1306_displayWait(TickType_t ticks) {
+  return SSD1306_dev_displayWait(&_default, ticks);
+}
+
+void SSD1306_setFlushCallback(void (*callback)(void *arg), void *arg) {
+  SSD1306_dev_setFlushCallback(&_default, callback, arg);
+}
+
+void SSD1306_getFlushStats(SSD1306_flushStats_t *stats) {
+  SSD1306_dev_getFlushStats(&_default, stats);
+}
+
+void SSD1306_resetFlushStats(void) {
+  SSD1306_dev_resetFlushStats(&_default);
+}
+
+int SSD1306_isDirty(void) {
+  return SSD1306_dev_isDirty(&_default);
+}
+
+int SSD1306_getDirtyRange(uint8 page, uint8 *x0, uint8 *x1) {
+  return SSD1306_dev_getDirtyRange(&_default, page, x0, x1);
+}
+
+void SSD1306_markDirty(void) {
+  SSD1306_dev_markDirty(&_default);
+}
+
+void SSD1306_clearDirty(void) {
+  SSD1306_dev_clearDirty(&_default);
+}
+
+void SSD1306_startScrollRight(uint8 start, uint8 stop) {
+  SSD1306_dev_startScrollRight(&_default, start, stop);
+}
+
+void SSD1306_startScrollLeft(uint8 start, uint8 stop) {
+  SSD1306_dev_startScrollLeft(&_default, start, stop);
+}
+
+void SSD1306_startScrollDiagRight(uint8 start, uint8 stop) {
+  SSD1306_dev_startScrollDiagRight(&_default, start, stop);
+}
+
+void SSD1306_startScrollDiagLeft(uint8 start, uint8 stop) {
+  SSD1306_dev_startScrollDiagLeft(&_default, start, stop);
+}
+
+void SSD1306_stopScroll(void) {
+  SSD1306_dev_stopScroll(&_default);
+}
+
+void SSD1306_dim(int dim) {
+  SSD1306_dev_dim(&_default, dim);
+}
+
+void SSD1306_drawPixel(int16 x, int16 y, uint16 color) {
+  SSD1306_dev_drawPixel(&_default, x, y, color);
+}
+
+void SSD1306_drawFastVLine(int16 x, int16 y, int16 h, uint16 color) {
+  SSD1306_dev_drawFastVLine(&_default, x, y, h, color);
+}
+
+void SSD1306_drawFastHLine(int16 x, int16 y, int16 w, uint16 color) {
+  SSD1306_dev_drawFastHLine(&_default, x, y, w, color);
+}
+
+void SSD1306_drawLine(int16 x0, int16 y0, int16 x1, int16 y1, uint16 color) {
+  SSD1306_dev_drawLine(&_default, x0, y0, x1, y1, color);
+}
+
+void SSD1306_drawRect(int16 x, int16 y, int16 w, int16 h, uint16 color) {
+  SSD1306_dev_drawRect(&_default, x, y, w, h, color);
+}
+
+void SSD1306_fillRect(int16 x, int16 y, int16 w, int16 h, uint16 color) {
+  SSD1306_dev_fillRect(&_default, x, y, w, h, color);
+}
+
+void SSD1306_fillScreen(uint16 color) {
+  SSD1306_dev_fillScreen(&_default, color);
+}
+
+SSD1306_rect_t SSD1306_scrollRegion(int16 x, int16 y, int16 w, int16 h,
+      int16 dx, int16 dy, uint16 fill) {
+  return SSD1306_dev_scrollRegion(&_default, x, y, w, h, dx, dy, fill);
+}
+
+void SSD1306_chartBegin(SSD1306_chart_t *chart, int16 x, int16 y,
+      uint8 w, uint8 h, int16 *samples, int16 min, int16 max, uint16 color, uint16 bg) {
+  SSD1306_dev_chartBegin(&_default, chart, x, y, w, h, samples, min, max, color, bg);
+}
+
+void SSD1306_chartPush(SSD1306_chart_t *chart, int16 value) {
+  SSD1306_dev_chartPush(&_default, chart, value);
+}
+
+void SSD1306_chartRedraw(SSD1306_chart_t *chart) {
+  SSD1306_dev_chartRedraw(&_default, chart);
+}
+
+void SSD1306_drawCircle(int16 x0, int16 y0, int16 r, uint16 color) {
+  SSD1306_dev_drawCircle(&_default, x0, y0, r, color);
+}
+
+void SSD1306_drawCircleHelper(int16 x0, int16 y0, int16 r, uint8 cornername, uint16 color) {
+  SSD1306_dev_drawCircleHelper(&_default, x0, y0, r, cornername, color);
+}
+
+void SSD1306_fillCircle(int16 x0, int16 y0, int16 r, uint16 color) {
+  SSD1306_dev_fillCircle(&_default, x0, y0, r, color);
+}
+
+void SSD1306_fillCircleHelper(int16 x0, int16 y0, int16 r, uint8 cornername, int16 delta, uint16 color) {
+  SSD1306_dev_fillCircleHelper(&_default, x0, y0, r, cornername, delta, color);
+}
+
+void SSD1306_fillEllipse(int16 x0, int16 y0, int16 rx, int16 ry, uint16 color) {
+  SSD1306_dev_fillEllipse(&_default, x0, y0, rx, ry, color);
+}
+
+void SSD1306_fillArc(int16 x0, int16 y0, int16 r, int16 thickness, int16 start, int16 end, uint16 color) {
+  SSD1306_dev_fillArc(&_default, x0, y0, r, thickness, start, end, color);
+}
+
+void SSD1306_fillPie(int16 x0, int16 y0, int16 r, int16 start, int16 end, uint16 color) {
+  SSD1306_dev_fillPie(&_default, x0, y0, r, start, end, color);
+}
+
+void SSD1306_drawTriangle(int16 x0, int16 y0, int16 x1, int16 y1, int16 x2, int16 y2, uint16 color) {
+  SSD1306_dev_drawTriangle(&_default, x0, y0, x1, y1, x2, y2, color);
+}
+
+void SSD1306_fillTriangle(int16 x0, int16 y0, int16 x1, int16 y1, int16 x2, int16 y2, uint16 color) {
+  SSD1306_dev_fillTriangle(&_default, x0, y0, x1, y1, x2, y2, color);
+}
+
+void SSD1306_fillPolygon(const SSD1306_point_t *points, uint8 count, uint16 color) {
+  SSD1306_dev_fillPolygon(&_default, points, count, color);
+}
+
+void SSD1306_drawRoundRect(int16 x0, int16 y0, int16 w, int16 h, int16 radius, uint16 color) {
+  SSD1306_dev_drawRoundRect(&_default, x0, y0, w, h, radius, color);
+}
+
+void SSD1306_fillRoundRect(int16 x0, int16 y0, int16 w, int16 h, int16 radius, uint16 color) {
+  SSD1306_dev_fillRoundRect(&_default, x0, y0, w, h, radius, color);
+}
+
+void SSD1306_drawBitmap(int16 x, int16 y, uint8 *bitmap, int16 w, int16 h, uint16 color, uint16 bg) {
+  SSD1306_dev_drawBitmap(&_default, x, y, bitmap, w, h, color, bg);
+}
+
+void SSD1306_drawXBitmap(int16 x, int16 y, const uint8 *bitmap, int16 w, int16 h, uint16 color) {
+  SSD1306_dev_drawXBitmap(&_default, x, y, bitmap, w, h, color);
+}
+
+void SSD1306_blit(int16 x, int16 y, const uint8 *bitmap, const uint8 *mask, int16 w, int16 h, uint8 op) {
+  SSD1306_dev_blit(&_default, x, y, bitmap, mask, w, h, op);
+}
+
+void SSD1306_forgetBitmaps(void) {
+  SSD1306_dev_forgetBitmaps(&_default);
+}
+
+void SSD1306_drawChar(int16 x, int16 y, uint16 c, uint16 color, uint16 bg, uint8 size) {
+  SSD1306_dev_drawChar(&_default, x, y, c, color, bg, size);
+}
+
+void SSD1306_setCursor(int16 x, int16 y) {
+  SSD1306_dev_setCursor(&_default, x, y);
+}
+
+void SSD1306_setTextColor(uint16 c, uint16 bg) {
+  SSD1306_dev_setTextColor(&_default, c, bg);
+}
+
+void SSD1306_setTextSize(uint8 s) {
+  SSD1306_dev_setTextSize(&_default, s);
+}
+
+void SSD1306_setTextWrap(int w) {
+  SSD1306_dev_setTextWrap(&_default, w);
+}
+
+void SSD1306_setRotation(uint8 r) {
+  SSD1306_dev_setRotation(&_default, r);
+}
+
+void SSD1306_cp437(int x) {
+  SSD1306_dev_cp437(&_default, x);
+}
+
+void SSD1306_setFont(const GFXfont *f) {
+  SSD1306_dev_setFont(&_default, f);
+}
+
+void SSD1306_setFontEx(const GFXfontEx *f) {
+  SSD1306_dev_setFontEx(&_default, f);
+}
+
+void SSD1306_getTextBounds(char *string, int16 x, int16 y, int16 *x1, int16 *y1, uint16 *w, uint16 *h) {
+  SSD1306_dev_getTextBounds(&_default, string, x, y, x1, y1, w, h);
+}
+
+uint8 SSD1306_layoutText(const char *str, int16 x, SSD1306_textLine_t *lines,
+                         uint8 maxLines) {
+  return SSD1306_dev_layoutText(&_default, str, x, lines, maxLines);
+}
+
+size_t SSD1306_write(uint8 c) {
+  return SSD1306_dev_write(&_default, c);
+}
+
+SSD1306_rect_t SSD1306_print(const char *str, size_t len) {
+  return SSD1306_dev_print(&_default, str, len);
+}
+
+SSD1306_rect_t SSD1306_printAt(int16 x, int16 y, const char *str, size_t len) {
+  return SSD1306_dev_printAt(&_default, x, y, str, len);
+}
+
+void SSD1306_terminalBegin(void) {
+  SSD1306_dev_terminalBegin(&_default);
+}
+
+void SSD1306_terminalEnd(void) {
+  SSD1306_dev_terminalEnd(&_default);
+}
+
+SSD1306_rect_t SSD1306_printInt(int32 value, uint8 width, char pad) {
+  return SSD1306_dev_printInt(&_default, value, width, pad);
+}
+
+SSD1306_rect_t SSD1306_printFixed(int32 value, uint8 decimals, uint8 width, char pad) {
+  return SSD1306_dev_printFixed(&_default, value, decimals, width, pad);
+}
+
+SSD1306_rect_t SSD1306_printHex(uint32 value, uint8 width, char pad) {
+  return SSD1306_dev_printHex(&_default, value, width, pad);
+}
+
+#if SSD1306_MAX_WIDGETS
+int8 SSD1306_addLabel(int16 x, int16 y, int16 w, int16 h, const char *text) {
+  return SSD1306_dev_addLabel(&_default, x, y, w, h, text);
+}
+
+int8 SSD1306_addValue(int16 x, int16 y, int16 w, int16 h, uint8 decimals) {
+  return SSD1306_dev_addValue(&_default, x, y, w, h, decimals);
+}
+
+int8 SSD1306_addBar(int16 x, int16 y, int16 w, int16 h,
+      uint16 color, uint16 bg, int32 min, int32 max) {
+  return SSD1306_dev_addBar(&_default, x, y, w, h, color, bg, min, max);
+}
+
+int8 SSD1306_addIcon(int16 x, int16 y, int16 w, int16 h,
+      uint16 color, uint16 bg, const uint8 *bitmap) {
+  return SSD1306_dev_addIcon(&_default, x, y, w, h, color, bg, bitmap);
+}
+
+void SSD1306_setWidgetText(int8 id, const char *text) {
+  SSD1306_dev_setWidgetText(&_default, id, text);
+}
+
+void SSD1306_setWidgetValue(int8 id, int32 value) {
+  SSD1306_dev_setWidgetValue(&_default, id, value);
+}
+
+void SSD1306_setWidgetBitmap(int8 id, const uint8 *bitmap) {
+  SSD1306_dev_setWidgetBitmap(&_default, id, bitmap);
+}
+
+void SSD1306_invalidate(int16 x, int16 y, int16 w, int16 h) {
+  SSD1306_dev_invalidate(&_default, x, y, w, h);
+}
+
+uint8 SSD1306_updateWidgets(void) {
+  return SSD1306_dev_updateWidgets(&_default);
+}
+
+void SSD1306_clearWidgets(void) {
+  SSD1306_dev_clearWidgets(&_default);
+}
+#endif
+
+int16 SSD1306_height(void) {
+  return SSD1306_dev_height(&_default);
+}
+
+int16 SSD1306_width(void) {
+  return SSD1306_dev_width(&_default);
+}
+
+uint8 SSD1306_getRotation(void) {
+  return SSD1306_dev_getRotation(&_default);
+}
+
+int16 SSD1306_getCursorX(void) {
+  return SSD1306_dev_getCursorX(&_default);
+}
+
+int16 SSD1306_getCursorY(void) {
+  return SSD1306_dev_getCursorY(&_default);
+}
+#endif // SSD1306_NO_DEFAULT
@@ -0,0 +1,355 @@
+/*
+ * Retained widgets for SSD1306 panels.  Labels, number fields, bar gauges
+ * and icons remember what they show, and are only redrawn when that
+ * changes, so the dirty spans left for the next flush cover just them.
+ *
+ * released under an MIT License
+ */
+
+#include "project.h"
+#include "SSD1306.h"
+#include "utils.h"
+
+#if SSD1306_MAX_WIDGETS
+static uint32 _hashText(const char *text)
+{
+  uint32 hash = 2166136261UL;
+
+  for (; text && *text; text++) {
+    hash = (hash ^ (uint8)*text) * 16777619UL;
+  }
+  return hash;
+}
+
+static SSD1306_widget_t *_widget(SSD1306_t *dev, int8 id)
+{
+  if (id < 0 || id >= dev->widget_count) {
+    return NULL;
+  }
+  return &dev->widgets[id];
+}
+
+static void _invalidateWidget(SSD1306_t *dev, SSD1306_widget_t *widget)
+{
+  widget->invalid = 1;
+  dev->widgets_invalid = 1;
+}
+
+static int8 _addWidget(SSD1306_t *dev, uint8 type, int16 x, int16 y, int16 w, int16 h,
+                       uint16 color, uint16 bg)
+{
+  if (dev->widget_count >= SSD1306_MAX_WIDGETS) {
+    return -1;
+  }
+
+  SSD1306_widget_t *widget = &dev->widgets[dev->widget_count];
+
+  memset(widget, 0, sizeof(*widget));
+  widget->rect.x = x;
+  widget->rect.y = y;
+  widget->rect.w = w;
+  widget->rect.h = h;
+  widget->type = type;
+  widget->color = color;
+  widget->bg = bg;
+  _invalidateWidget(dev, widget);
+  return dev->widget_count++;
+}
+
+// Text widgets take the panel's current font, size and colors.  GFXfont
+// text hangs from its baseline, so find how far the tallest glyph reaches
+// above it, and the widest how far left of the cursor, once here rather
+// than measuring at every redraw.  Placing the cursor by those keeps the
+// text inside the widget's top and left edges.
+static int8 _addTextWidget(SSD1306_t *dev, uint8 type, int16 x, int16 y, int16 w, int16 h)
+{
+  int8 id = _addWidget(dev, type, x, y, w, h, dev->textcolor, dev->textbgcolor);
+  if (id < 0) {
+    return id;
+  }
+
+  SSD1306_widget_t *widget = &dev->widgets[id];
+  const GFXfontEx *fx = dev->gfxFontEx;
+  widget->font = dev->gfxFont;
+  widget->fontEx = fx;
+  widget->size = dev->textsize;
+
+  if (widget->font) {
+    int16 top = 0;
+    int16 left = 0;
+    if (fx) {
+      // Only the glyphs the ranges use
+      for (uint16 i = 0; i < fx->rangeCount; i++) {
+        const GFXrange *range = &fx->ranges[i];
+        for (uint16 g = range->glyph; g < range->glyph + range->count; g++) {
+          top = min(top, widget->font->glyph[g].yOffset);
+          left = min(left, widget->font->glyph[g].xOffset);
+        }
+      }
+    } else {
+      for (uint16 c = widget->font->first; c <= widget->font->last; c++) {
+        top = min(top, widget->font->glyph[c - widget->font->first].yOffset);
+        left = min(left, widget->font->glyph[c - widget->font->first].xOffset);
+      }
+    }
+    widget->baseline = -top * widget->size;
+    widget->indent = -left * widget->size;
+  }
+  return id;
+}
+
+int8 SSD1306_dev_addLabel(SSD1306_t *dev, int16 x, int16 y, int16 w, int16 h, const char *text)
+{
+  int8 id = _addTextWidget(dev, SSD1306_WIDGET_LABEL, x, y, w, h);
+  if (id >= 0) {
+    dev->widgets[id].text = text;
+    dev->widgets[id].hash = _hashText(text);
+  }
+  return id;
+}
+
+int8 SSD1306_dev_addValue(SSD1306_t *dev, int16 x, int16 y, int16 w, int16 h, uint8 decimals)
+{
+  int8 id = _addTextWidget(dev, SSD1306_WIDGET_VALUE, x, y, w, h);
+  if (id >= 0) {
+    dev->widgets[id].decimals = decimals;
+  }
+  return id;
+}
+
+int8 SSD1306_dev_addBar(SSD1306_t *dev, int16 x, int16 y, int16 w, int16 h,
+                        uint16 color, uint16 bg, int32 min, int32 max)
+{
+  int8 id = _addWidget(dev, SSD1306_WIDGET_BAR, x, y, w, h, color, bg);
+  if (id >= 0) {
+    dev->widgets[id].min = min;
+    dev->widgets[id].max = max;
+    dev->widgets[id].value = min;
+  }
+  return id;
+}
+
+int8 SSD1306_dev_addIcon(SSD1306_t *dev, int16 x, int16 y, int16 w, int16 h,
+                         uint16 color, uint16 bg, const uint8 *bitmap)
+{
+  int8 id = _addWidget(dev, SSD1306_WIDGET_ICON, x, y, w, h, color, bg);
+  if (id >= 0) {
+    dev->widgets[id].bitmap = bitmap;
+  }
+  return id;
+}
+
+// Pixels of a bar filled at a level.  Ranges wider than 16 bits are
+// scaled down first so the multiply by the width fits in 32 bits, which
+// can only cost the last pixel of rounding.
+static int16 _barLength(SSD1306_widget_t *widget, int32 value)
+{
+  if (widget->max <= widget->min) {
+    return 0;
+  }
+
+  uint32 range = (uint32)widget->max - (uint32)widget->min;
+  uint32 level = (uint32)clamp(value, widget->min, widget->max) - (uint32)widget->min;
+
+  while (range > 0xFFFF) {
+    range >>= 1;
+    level >>= 1;
+  }
+  return level * widget->rect.w / range;
+}
+
+// The text is not copied: it may be changed in place and set again, which
+// is spotted by its hash
+void SSD1306_dev_setWidgetText(SSD1306_t *dev, int8 id, const char *text)
+{
+  SSD1306_widget_t *widget = _widget(dev, id);
+  if (!widget) {
+    return;
+  }
+
+  uint32 hash = _hashText(text);
+  if (text != widget->text || hash != widget->hash) {
+    widget->text = text;
+    widget->hash = hash;
+    _invalidateWidget(dev, widget);
+  }
+}
+
+void SSD1306_dev_setWidgetValue(SSD1306_t *dev, int8 id, int32 value)
+{
+  SSD1306_widget_t *widget = _widget(dev, id);
+  if (!widget || value == widget->value) {
+    return;
+  }
+
+  int32 was = widget->value;
+  widget->value = value;
+
+  // A bar only changes when its length in pixels does
+  if (widget->type == SSD1306_WIDGET_BAR && _barLength(widget, was) == _barLength(widget, value)) {
+    return;
+  }
+
+  _invalidateWidget(dev, widget);
+}
+
+void SSD1306_dev_setWidgetBitmap(SSD1306_t *dev, int8 id, const uint8 *bitmap)
+{
+  SSD1306_widget_t *widget = _widget(dev, id);
+  if (!widget || bitmap == widget->bitmap) {
+    return;
+  }
+
+  widget->bitmap = bitmap;
+  _invalidateWidget(dev, widget);
+}
+
+static uint8 _rectsOverlap(const SSD1306_rect_t *a, int16 x, int16 y, int16 w, int16 h)
+{
+  return (a->x < x + w) && (x < a->x + (int16)a->w) &&
+         (a->y < y + h) && (y < a->y + (int16)a->h);
+}
+
+void SSD1306_dev_invalidate(SSD1306_t *dev, int16 x, int16 y, int16 w, int16 h)
+{
+  for (uint8 i = 0; i < dev->widget_count; i++) {
+    SSD1306_widget_t *widget = &dev->widgets[i];
+    if (!widget->invalid && _rectsOverlap(&widget->rect, x, y, w, h)) {
+      _invalidateWidget(dev, widget);
+    }
+  }
+}
+
+static void _drawWidget(SSD1306_t *dev, SSD1306_widget_t *widget)
+{
+  SSD1306_rect_t *r = &widget->rect;
+
+  switch (widget->type) {
+  case SSD1306_WIDGET_BAR: {
+    int16 len = _barLength(widget, widget->value);
+
+    SSD1306_dev_fillRect(dev, r->x, r->y, len, r->h, widget->color);
+    SSD1306_dev_fillRect(dev, r->x + len, r->y, r->w - len, r->h, widget->bg);
+    break;
+  }
+
+  case SSD1306_WIDGET_ICON:
+    SSD1306_dev_fillRect(dev, r->x, r->y, r->w, r->h, widget->bg);
+    if (widget->bitmap) {
+      SSD1306_dev_drawBitmap(dev, r->x, r->y, (uint8 *)widget->bitmap, r->w, r->h,
+                             widget->color, widget->bg);
+    }
+    break;
+
+  default: {
+    // Text never reaches above or left of the cursor placed by baseline
+    // and indent.  Narrowing the panel to the widget's right and bottom
+    // edges clips what runs past those, so nothing is left outside the
+    // area the next redraw erases.
+    int16 width = dev->width;
+    int16 height = dev->height;
+
+    SSD1306_dev_fillRect(dev, r->x, r->y, r->w, r->h, widget->bg);
+    dev->gfxFont = (GFXfont *)widget->font;
+    dev->gfxFontEx = widget->fontEx;
+    dev->textsize = widget->size;
+    dev->textcolor = widget->color;
+    dev->textbgcolor = widget->bg;
+    dev->width = min(width, r->x + (int16)r->w);
+    dev->height = min(height, r->y + (int16)r->h);
+    SSD1306_dev_setCursor(dev, r->x + widget->indent, r->y + widget->baseline);
+
+    if (widget->type == SSD1306_WIDGET_VALUE) {
+      SSD1306_dev_printFixed(dev, widget->value, widget->decimals, 0, ' ');
+    } else if (widget->text) {
+      SSD1306_dev_print(dev, widget->text, strlen(widget->text));
+    }
+
+    dev->width = width;
+    dev->height = height;
+    break;
+  }
+  }
+}
+
+// Redraw the widgets whose contents changed.  A widget overlapping one
+// being redrawn is redrawn too, in the order they were added, so the
+// later one still ends up on top.
+uint8 SSD1306_dev_updateWidgets(SSD1306_t *dev)
+{
+  uint8 drawn = 0;
+
+  if (!dev->widgets_invalid) {
+    return 0;
+  }
+
+  for (uint8 spread = 1; spread; ) {
+    spread = 0;
+    for (uint8 i = 0; i < dev->widget_count; i++) {
+      SSD1306_widget_t *widget = &dev->widgets[i];
+      if (!widget->invalid) {
+        continue;
+      }
+      for (uint8 j = 0; j < dev->widget_count; j++) {
+        SSD1306_widget_t *other = &dev->widgets[j];
+        if (!other->invalid &&
+            _rectsOverlap(&other->rect, widget->rect.x, widget->rect.y,
+                          widget->rect.w, widget->rect.h)) {
+          other->invalid = 1;
+          spread = 1;
+        }
+      }
+    }
+  }
+
+  // Text widgets draw with the panel's text state; put it back afterwards.
+  // They always draw into the framebuffer, even in terminal mode, and a
+  // UTF-8 sequence the caller is part way through writing is kept.
+  int16 cursor_x = dev->cursor_x;
+  int16 cursor_y = dev->cursor_y;
+  uint16 textcolor = dev->textcolor;
+  uint16 textbgcolor = dev->textbgcolor;
+  uint8 textsize = dev->textsize;
+  int wrap = dev->wrap;
+  GFXfont *gfxFont = dev->gfxFont;
+  const GFXfontEx *gfxFontEx = dev->gfxFontEx;
+  uint8 term = dev->term;
+  uint16 utf8_cp = dev->utf8_cp;
+  uint8 utf8_pending = dev->utf8_pending;
+
+  dev->wrap = 0;
+  dev->term = 0;
+  dev->utf8_pending = 0;
+
+  for (uint8 i = 0; i < dev->widget_count; i++) {
+    SSD1306_widget_t *widget = &dev->widgets[i];
+    if (widget->invalid) {
+      _drawWidget(dev, widget);
+      widget->invalid = 0;
+      drawn++;
+    }
+  }
+
+  dev->cursor_x = cursor_x;
+  dev->cursor_y = cursor_y;
+  dev->textcolor = textcolor;
+  dev->textbgcolor = textbgcolor;
+  dev->textsize = textsize;
+  dev->wrap = wrap;
+  dev->gfxFont = gfxFont;
+  dev->gfxFontEx = gfxFontEx;
+  dev->term = term;
+  dev->utf8_cp = utf8_cp;
+  dev->utf8_pending = utf8_pending;
+
+  dev->widgets_invalid = 0;
+  return drawn;
+}
+
+// Forget every widget.  What they drew stays on the screen.
+void SSD1306_dev_clearWidgets(SSD1306_t *dev)
+{
+  dev->widget_count = 0;
+  dev->widgets_invalid = 0;
+}
+#endif // SSD1306_MAX_WIDGETS
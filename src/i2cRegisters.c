@@ -16,9 +16,22 @@
 
 #include "FreeRTOS.h"
 #include "semphr.h"
+#include "task.h"
 
 static uint8 i2c_initialized = 0;
 static SemaphoreHandle_t i2cBusSemaphore;
+static SemaphoreHandle_t i2cDoneSemaphore;
+
+// Interrupt-driven engine state.  Two staging buffers, so one can be
+// filled while the other is on the bus.
+static const i2c_hw_t *i2c_hw = NULL;
+static uint8 i2c_tx_buffer[2][I2C_TX_BUFFER_SIZE];
+static uint8 i2c_tx_index;
+static uint16 i2c_tx_len;
+static volatile uint8 i2c_tx_pending;
+static uint8 i2c_tx_error;
+static uint8 i2c_tx_addr;
+static uint8 i2c_tx_regnum;
 
 // Silly API changes between builtin I2C on PSOC5 and the SCB-based one on PSOC4
 #if CY_PSOC4
@@ -27,6 +40,15 @@ static SemaphoreHandle_t i2cBusSemaphore;
 #define I2C_MasterSendRestart(x, y) I2C_I2CMasterSendRestart(x, y, 0)
 #define I2C_MasterReadByteY(x, y)   I2C_I2CMasterReadByte(x, &y, 0)
 #define I2C_MasterSendStop()        I2C_I2CMasterSendStop(0)
+#define I2C_MasterWriteBuf(a, b, c, m) I2C_I2CMasterWriteBuf(a, b, c, m)
+#define I2C_MasterStatus()          I2C_I2CMasterStatus()
+#define I2C_MasterClearStatus()     I2C_I2CMasterClearStatus()
+#define I2C_MODE_COMPLETE_XFER      I2C_I2C_MODE_COMPLETE_XFER
+#define I2C_MSTAT_WR_CMPLT          I2C_I2C_MSTAT_WR_CMPLT
+#define I2C_MSTAT_ERR_XFER          I2C_I2C_MSTAT_ERR_XFER
+#define I2C_MSTR_NO_ERROR           I2C_I2C_MSTR_NO_ERROR
+#define I2C_MSTR_BUS_BUSY           I2C_I2C_MSTR_BUS_BUSY
+#define I2C_MSTR_NOT_READY          I2C_I2C_MSTR_NOT_READY
 #define ERROR_NAK   I2C_I2C_MSTR_ERR_LB_NAK
 #elif CY_PSOC5
 #define I2C_MasterReadByteY(x, y)   y = I2C_MasterReadByte(x)
@@ -35,9 +57,80 @@ static SemaphoreHandle_t i2cBusSemaphore;
 
 static void i2c_initialize(void) {
     i2cBusSemaphore = xSemaphoreCreateRecursiveMutex();
+    i2cDoneSemaphore = xSemaphoreCreateBinary();
     i2c_initialized = 1;
 }
 
+// PSoC hardware shim: the component's buffered master API runs the
+// transfer from its own interrupt.  For a prompt wakeup, call
+// i2c_transfer_complete_isr() from the component's ISR exit callback
+// (I2C_ISR_ExitCallback in cyapicallbacks.h); otherwise the waiting task
+// checks the status once per tick.
+static uint8 i2c_psoc_write_async(uint8 addr, uint8 *buffer, uint16 len)
+{
+    uint32 status;
+
+    I2C_MasterClearStatus();
+    status = I2C_MasterWriteBuf(addr, buffer, len, I2C_MODE_COMPLETE_XFER);
+    if (status == I2C_MSTR_NO_ERROR) {
+        return I2C_XFER_OK;
+    }
+    if (status == I2C_MSTR_BUS_BUSY || status == I2C_MSTR_NOT_READY) {
+        return I2C_XFER_BUSY;
+    }
+    return I2C_XFER_ERROR;
+}
+
+static uint8 i2c_psoc_poll(void)
+{
+    uint32 status = I2C_MasterStatus();
+
+    if (status & I2C_MSTAT_ERR_XFER) {
+        return I2C_XFER_ERROR;
+    }
+    if (status & I2C_MSTAT_WR_CMPLT) {
+        return I2C_XFER_OK;
+    }
+    return I2C_XFER_BUSY;
+}
+
+const i2c_hw_t i2c_hw_psoc = {
+    i2c_psoc_write_async,
+    i2c_psoc_poll,
+};
+
+void i2c_transfer_complete_isr(void)
+{
+    BaseType_t woken = pdFALSE;
+
+    // The PSoC exit callback runs on every byte, so only wake the task
+    // once the transfer in flight has actually finished
+    if (!i2c_tx_pending || i2c_hw->poll() == I2C_XFER_BUSY) {
+        return;
+    }
+
+    xSemaphoreGiveFromISR(i2cDoneSemaphore, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+// Sleep until the transfer in flight is done.  The hardware status has the
+// last word, so a stray wakeup can't end the wait early.
+static void i2c_async_wait(void)
+{
+    uint8 state;
+
+    while (i2c_tx_pending) {
+        xSemaphoreTake(i2cDoneSemaphore, 1);
+        state = i2c_hw->poll();
+        if (state != I2C_XFER_BUSY) {
+            if (state == I2C_XFER_ERROR) {
+                i2c_tx_error = 1;
+            }
+            i2c_tx_pending = 0;
+        }
+    }
+}
+
 uint8 i2c_register_test_device(uint8 addr)
 {
     uint32 status;
@@ -63,6 +156,7 @@ uint8 i2c_register_read(uint8 addr, uint8 regnum)
     }
     
     xSemaphoreTakeRecursive(i2cBusSemaphore, portMAX_DELAY);
+    i2c_async_wait();
     I2C_MasterSendStart(addr, 0);
     I2C_MasterWriteByte(regnum);
     I2C_MasterSendRestart(addr, 1);
@@ -80,6 +174,7 @@ void i2c_register_write(uint8 addr, uint8 regnum, uint8 value)
     }
     
     xSemaphoreTakeRecursive(i2cBusSemaphore, portMAX_DELAY);
+    i2c_async_wait();
     I2C_MasterSendStart(addr, 0);
     I2C_MasterWriteByte(regnum);
     I2C_MasterWriteByte(value);
@@ -95,6 +190,7 @@ uint8 i2c_register_read_noreg(uint8 addr)
     }
     
     xSemaphoreTakeRecursive(i2cBusSemaphore, portMAX_DELAY);
+    i2c_async_wait();
     I2C_MasterSendStart(addr, 1);
     I2C_MasterReadByteY(1, value);
     I2C_MasterSendStop();
@@ -109,6 +205,7 @@ void i2c_register_write_noreg(uint8 addr, uint8 value)
     }
     
     xSemaphoreTakeRecursive(i2cBusSemaphore, portMAX_DELAY);
+    i2c_async_wait();
     I2C_MasterSendStart(addr, 0);
     I2C_MasterWriteByte(value);
     I2C_MasterSendStop();
@@ -123,6 +220,7 @@ uint16 i2c_register_read_msb16(uint8 addr, uint8 basereg)
     }
     
     xSemaphoreTakeRecursive(i2cBusSemaphore, portMAX_DELAY);
+    i2c_async_wait();
     uint16 value = TO_BYTE_C(i2c_register_read(addr, basereg));
     value |= TO_BYTE_D(i2c_register_read(addr, basereg + 1));
     xSemaphoreGiveRecursive(i2cBusSemaphore);
@@ -136,6 +234,7 @@ uint16 i2c_register_read_lsb16(uint8 addr, uint8 basereg)
     }
     
     xSemaphoreTakeRecursive(i2cBusSemaphore, portMAX_DELAY);
+    i2c_async_wait();
     uint16 value = TO_BYTE_D(i2c_register_read(addr, basereg));
     value |= TO_BYTE_C(i2c_register_read(addr, basereg + 1));
     xSemaphoreGiveRecursive(i2cBusSemaphore);
@@ -151,6 +250,7 @@ uint16 i2c_register_read16be(uint8 addr, uint8 regnum)
     }
     
     xSemaphoreTakeRecursive(i2cBusSemaphore, portMAX_DELAY);
+    i2c_async_wait();
     I2C_MasterSendStart(addr, 0);
     I2C_MasterWriteByte(regnum);
     I2C_MasterSendRestart(addr, 1);
@@ -170,6 +270,7 @@ void i2c_register_write16be(uint8 addr, uint8 regnum, uint16 value)
     }
     
     xSemaphoreTakeRecursive(i2cBusSemaphore, portMAX_DELAY);
+    i2c_async_wait();
     I2C_MasterSendStart(addr, 0);
     I2C_MasterWriteByte(regnum);
     I2C_MasterWriteByte(BYTE_D(value));
@@ -179,15 +280,16 @@ void i2c_register_write16be(uint8 addr, uint8 regnum, uint16 value)
 }
 
 
-void i2c_register_write_buffer(uint8 addr, uint8 regnum, uint8 *buffer, uint8 len)
+void i2c_register_write_buffer(uint8 addr, uint8 regnum, uint8 *buffer, uint16 len)
 {
-    int i;
+    uint16 i;
 
     if (!i2c_initialized) {
         i2c_initialize();
     }
     
     xSemaphoreTakeRecursive(i2cBusSemaphore, portMAX_DELAY);
+    i2c_async_wait();
     I2C_MasterSendStart(addr, 0);
     I2C_MasterWriteByte(regnum);
     for (i = 0; i < len; i++ ) {
@@ -197,4 +299,156 @@ void i2c_register_write_buffer(uint8 addr, uint8 regnum, uint8 *buffer, uint8 le
     xSemaphoreGiveRecursive(i2cBusSemaphore);
 }
 
+void i2c_set_hw(const i2c_hw_t *hw)
+{
+    if (!i2c_initialized) {
+        i2c_initialize();
+    }
+    
+    xSemaphoreTakeRecursive(i2cBusSemaphore, portMAX_DELAY);
+    i2c_async_wait();
+    i2c_hw = hw;
+    xSemaphoreGiveRecursive(i2cBusSemaphore);
+}
+
+// Send the staging buffer being filled, then start filling the other one
+// with the register byte of the same transfer
+static void i2c_async_kick(void)
+{
+    uint8 state;
+    uint8 tries = 0;
+
+    i2c_async_wait();
+
+    // Once part of a transfer has failed, the rest of it is dropped
+    if (!i2c_tx_error) {
+        // Drop any wakeup left over from the last transfer
+        xSemaphoreTake(i2cDoneSemaphore, 0);
+        i2c_tx_pending = 1;
+        while ((state = i2c_hw->write_async(i2c_tx_addr, i2c_tx_buffer[i2c_tx_index],
+                                            i2c_tx_len)) == I2C_XFER_BUSY &&
+               ++tries < I2C_START_RETRIES) {
+            vTaskDelay(1);
+        }
+        if (state != I2C_XFER_OK) {
+            i2c_tx_pending = 0;
+            i2c_tx_error = 1;
+        }
+    }
+
+    i2c_tx_index ^= 1;
+    i2c_tx_buffer[i2c_tx_index][0] = i2c_tx_regnum;
+    i2c_tx_len = 1;
+}
+
+static void i2c_async_append(uint8 *buffer, uint16 len)
+{
+    while (len) {
+        uint16 count = min(len, I2C_TX_BUFFER_SIZE - i2c_tx_len);
+
+        memcpy(&i2c_tx_buffer[i2c_tx_index][i2c_tx_len], buffer, count);
+        i2c_tx_len += count;
+        buffer += count;
+        len -= count;
+
+        if (i2c_tx_len == I2C_TX_BUFFER_SIZE) {
+            i2c_async_kick();
+        }
+    }
+}
+
+void i2c_register_stream_begin(uint8 addr, uint8 regnum)
+{
+    if (!i2c_initialized) {
+        i2c_initialize();
+    }
+    
+    xSemaphoreTakeRecursive(i2cBusSemaphore, portMAX_DELAY);
+    if (i2c_hw) {
+        i2c_async_wait();
+        i2c_tx_error = 0;
+        i2c_tx_addr = addr;
+        i2c_tx_regnum = regnum;
+        i2c_tx_buffer[i2c_tx_index][0] = regnum;
+        i2c_tx_len = 1;
+        return;
+    }
+
+    I2C_MasterSendStart(addr, 0);
+    I2C_MasterWriteByte(regnum);
+}
+
+void i2c_register_stream_write(uint8 *buffer, uint16 len)
+{
+    if (i2c_hw) {
+        i2c_async_append(buffer, len);
+        return;
+    }
+
+    while (len--) {
+        I2C_MasterWriteByte(*(buffer++));
+    }
+}
+
+uint8 i2c_register_stream_end(void)
+{
+    uint8 status = I2C_XFER_OK;
+
+    if (i2c_hw) {
+        if (i2c_tx_len > 1) {
+            i2c_async_kick();
+        }
+        i2c_async_wait();
+        if (i2c_tx_error) {
+            status = I2C_XFER_ERROR;
+        }
+    } else {
+        I2C_MasterSendStop();
+    }
+    xSemaphoreGiveRecursive(i2cBusSemaphore);
+    return status;
+}
+
+// Queue a write and return as soon as the last part of it has been handed
+// to the hardware.  The bus stays held until i2c_register_wait() is called
+// from the same task, which reports whether every part of it went out.
+// Without a hardware shim this is a blocking write.
+void i2c_register_write_buffer_async(uint8 addr, uint8 regnum, uint8 *buffer, uint16 len)
+{
+    if (!i2c_initialized) {
+        i2c_initialize();
+    }
+    
+    xSemaphoreTakeRecursive(i2cBusSemaphore, portMAX_DELAY);
+    if (!i2c_hw) {
+        i2c_register_write_buffer(addr, regnum, buffer, len);
+        return;
+    }
+
+    i2c_async_wait();
+    i2c_tx_error = 0;
+    i2c_tx_addr = addr;
+    i2c_tx_regnum = regnum;
+    i2c_tx_buffer[i2c_tx_index][0] = regnum;
+    i2c_tx_len = 1;
+    i2c_async_append(buffer, len);
+    if (i2c_tx_len > 1) {
+        i2c_async_kick();
+    }
+}
+
+uint8 i2c_register_wait(void)
+{
+    uint8 status = I2C_XFER_OK;
+
+    if (i2c_hw) {
+        i2c_async_wait();
+        if (i2c_tx_error) {
+            status = I2C_XFER_ERROR;
+        }
+    }
+    xSemaphoreGiveRecursive(i2cBusSemaphore);
+    return status;
+}
+
 /* [] END OF FILE */
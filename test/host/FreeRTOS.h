@@ -0,0 +1,23 @@
+/*
+ * Host stand-in for the FreeRTOS headers: a single task, where sleeping
+ * lets simulated bus time pass.
+ *
+ * released under an MIT License
+ */
+
+#ifndef __FreeRTOS_h__
+#define __FreeRTOS_h__
+
+#include <stdint.h>
+
+typedef void *SemaphoreHandle_t;
+typedef uint32_t TickType_t;
+typedef long BaseType_t;
+
+#define pdFALSE 0
+#define pdTRUE  1
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFFUL)
+#define configTICK_RATE_HZ 1000
+#define portYIELD_FROM_ISR(x) ((void)(x))
+
+#endif // __FreeRTOS_h__
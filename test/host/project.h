@@ -0,0 +1,42 @@
+/*
+ * Just enough of the PSoC Creator generated project.h to build
+ * i2cRegisters.c on a host.  The blocking I2C calls are stubbed in the
+ * test itself.
+ *
+ * released under an MIT License
+ */
+
+#ifndef __project_h__
+#define __project_h__
+
+#include <stdint.h>
+#include <string.h>
+
+typedef uint8_t  uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+typedef int8_t   int8;
+typedef int16_t  int16;
+typedef int32_t  int32;
+
+#define CY_PSOC4 0
+#define CY_PSOC5 1
+
+#define I2C_MODE_COMPLETE_XFER  0x00
+#define I2C_MSTAT_WR_CMPLT      0x02
+#define I2C_MSTAT_ERR_XFER      0x80
+#define I2C_MSTR_NO_ERROR       0x00
+#define I2C_MSTR_BUS_BUSY       0x01
+#define I2C_MSTR_NOT_READY      0x02
+#define I2C_MSTR_ERR_LB_NAK     0x02
+
+uint8 I2C_MasterSendStart(uint8 addr, uint8 read);
+uint8 I2C_MasterSendRestart(uint8 addr, uint8 read);
+uint8 I2C_MasterSendStop(void);
+uint8 I2C_MasterWriteByte(uint8 value);
+uint8 I2C_MasterReadByte(uint8 ack);
+uint8 I2C_MasterWriteBuf(uint8 addr, uint8 *buffer, uint32 len, uint8 mode);
+uint32 I2C_MasterStatus(void);
+uint32 I2C_MasterClearStatus(void);
+
+#endif // __project_h__
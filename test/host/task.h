@@ -0,0 +1,22 @@
+#ifndef __task_h__
+#define __task_h__
+
+#include "FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *arg);
+
+#define tskIDLE_PRIORITY        0
+#define configMINIMAL_STACK_SIZE 128
+
+// One task, so there is nothing to keep out
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+
+void vTaskDelay(TickType_t ticks);
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint16_t stack,
+                       void *arg, BaseType_t priority, TaskHandle_t *handle);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+
+#endif // __task_h__
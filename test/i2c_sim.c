@@ -0,0 +1,143 @@
+/*
+ * Simulated I2C bus behind the i2c_hw_t shim.  A started write moves
+ * I2C_SIM_BYTES_PER_TICK bytes per tick, raising the "interrupt" after
+ * every byte the way the PSoC component's exit callback does, and copies
+ * them out of the caller's buffer as it goes, so a staging buffer reused
+ * while still on the bus shows up as corrupt data in the log.
+ *
+ * released under an MIT License
+ */
+
+#include "i2c_sim.h"
+
+typedef struct {
+    uint8 addr;
+    uint16 offset;
+    uint16 len;
+} i2c_sim_txn_t;
+
+static i2c_sim_txn_t sim_txns[I2C_SIM_MAX_TXNS];
+static uint16 sim_txn_count;
+static uint8 sim_log[I2C_SIM_LOG_BYTES];
+static uint16 sim_log_len;
+
+// The write on the bus
+static uint8 *sim_buffer;
+static uint16 sim_len;
+static uint16 sim_sent;
+static uint8 sim_state = I2C_XFER_OK;
+
+static uint16 sim_busy_every;
+static uint8 sim_busy_always;
+static uint16 sim_starts;
+static uint16 sim_nak_in;
+
+void i2c_sim_reset(void)
+{
+    sim_txn_count = 0;
+    sim_log_len = 0;
+    sim_buffer = NULL;
+    sim_state = I2C_XFER_OK;
+    sim_busy_every = 0;
+    sim_busy_always = 0;
+    sim_starts = 0;
+    sim_nak_in = 0;
+}
+
+static uint8 i2c_sim_write_async(uint8 addr, uint8 *buffer, uint16 len)
+{
+    if (sim_buffer) {
+        // Started over the top of a write still on the bus
+        return I2C_XFER_ERROR;
+    }
+
+    sim_starts++;
+    if (sim_busy_always || (sim_busy_every && sim_starts % sim_busy_every == 0)) {
+        return I2C_XFER_BUSY;
+    }
+
+    if (sim_txn_count == I2C_SIM_MAX_TXNS || sim_log_len + len > I2C_SIM_LOG_BYTES) {
+        return I2C_XFER_ERROR;
+    }
+
+    sim_txns[sim_txn_count].addr = addr;
+    sim_txns[sim_txn_count].offset = sim_log_len;
+    sim_txns[sim_txn_count].len = 0;
+    sim_buffer = buffer;
+    sim_len = len;
+    sim_sent = 0;
+    sim_state = I2C_XFER_BUSY;
+    return I2C_XFER_OK;
+}
+
+static uint8 i2c_sim_poll(void)
+{
+    return sim_state;
+}
+
+const i2c_hw_t i2c_sim_hw = {
+    i2c_sim_write_async,
+    i2c_sim_poll,
+};
+
+void i2c_sim_tick(void)
+{
+    uint16 i;
+
+    for (i = 0; sim_buffer && i < I2C_SIM_BYTES_PER_TICK; i++) {
+        if (sim_nak_in == 1) {
+            sim_state = I2C_XFER_ERROR;
+        } else {
+            sim_log[sim_log_len++] = sim_buffer[sim_sent++];
+            sim_txns[sim_txn_count].len++;
+            if (sim_sent == sim_len) {
+                sim_state = I2C_XFER_OK;
+            }
+        }
+
+        if (sim_state != I2C_XFER_BUSY) {
+            if (sim_state == I2C_XFER_OK) {
+                sim_txn_count++;
+            } else {
+                sim_log_len = sim_txns[sim_txn_count].offset;
+            }
+            if (sim_nak_in) {
+                sim_nak_in--;
+            }
+            sim_buffer = NULL;
+        }
+        i2c_transfer_complete_isr();
+    }
+}
+
+uint8 i2c_sim_active(void)
+{
+    return sim_buffer != NULL;
+}
+
+void i2c_sim_busy_every(uint16 n)
+{
+    sim_busy_every = n;
+}
+
+void i2c_sim_busy_always(uint8 on)
+{
+    sim_busy_always = on;
+}
+
+void i2c_sim_nak_txn(uint16 n)
+{
+    sim_nak_in = n;
+}
+
+uint16 i2c_sim_txn_count(void)
+{
+    return sim_txn_count;
+}
+
+const uint8 *i2c_sim_txn(uint16 i, uint8 *addr, uint16 *len)
+{
+    *addr = sim_txns[i].addr;
+    *len = sim_txns[i].len;
+    return &sim_log[sim_txns[i].offset];
+}
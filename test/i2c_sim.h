@@ -0,0 +1,40 @@
+/*
+ * Simulated I2C bus behind the i2c_hw_t shim, so the interrupt-driven
+ * transfer engine in i2cRegisters.c can be exercised on a host.
+ *
+ * released under an MIT License
+ */
+
+#ifndef __i2c_sim_h__
+#define __i2c_sim_h__
+
+#include "project.h"
+#include "i2cRegisters.h"
+
+#define I2C_SIM_MAX_TXNS        64
+#define I2C_SIM_LOG_BYTES       8192
+#define I2C_SIM_BYTES_PER_TICK  16
+
+extern const i2c_hw_t i2c_sim_hw;
+
+// Forget every logged transaction and injected fault
+void i2c_sim_reset(void);
+
+// Let one tick of bus time pass.  The host RTOS stubs call this wherever
+// a task would sleep.
+void i2c_sim_tick(void);
+
+// Whether a write is on the bus right now
+uint8 i2c_sim_active(void);
+
+// Faults: report the bus busy on every nth start (0 for never) or on
+// every start, and NAK the nth transaction from now (1 for the next)
+void i2c_sim_busy_every(uint16 n);
+void i2c_sim_busy_always(uint8 on);
+void i2c_sim_nak_txn(uint16 n);
+
+// The transactions that completed, in bus order
+uint16 i2c_sim_txn_count(void);
+const uint8 *i2c_sim_txn(uint16 i, uint8 *addr, uint16 *len);
+
+#endif // __i2c_sim_h__
@@ -0,0 +1,272 @@
+/*
+ * Runs the interrupt-driven transfer engine in i2cRegisters.c against the
+ * simulated bus, checking that streams longer than I2C_TX_BUFFER_SIZE
+ * arrive intact and in order, that blocking calls wait for a queued
+ * transfer, and that bus errors reach the caller.  Build and run on a
+ * host from the top of the tree:
+ *
+ *   cc -Wall -Itest/host -Iinclude -Itest src/i2cRegisters.c \
+ *       test/i2c_sim.c test/i2c_stream_test.c -o i2c_stream_test
+ *   ./i2c_stream_test
+ *
+ * released under an MIT License
+ */
+
+#include <stdio.h>
+
+#include "project.h"
+#include "i2cRegisters.h"
+#include "i2c_sim.h"
+#include "utils.h"
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
+
+#define ADDR    0x3C
+#define REGNUM  0x40
+
+static int failures;
+static uint16 collisions;
+static uint8 pattern[1200];
+
+#define check(cond, ...) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        failures++; \
+    } \
+} while (0)
+
+/*
+ * One task and no preemption: a sleep is where bus time passes, and the
+ * simulated interrupts run from inside it.
+ */
+static BaseType_t sem_count[2];
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return &sem_count[0];
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void)
+{
+    return &sem_count[1];
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    BaseType_t *count = sem;
+
+    while (!*count && ticks) {
+        i2c_sim_tick();
+        ticks--;
+    }
+    if (!*count) {
+        return pdFALSE;
+    }
+    *count = 0;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    *(BaseType_t *)sem = 1;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t *woken)
+{
+    *woken = pdTRUE;
+    return xSemaphoreGive(sem);
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    (void)sem;
+    (void)ticks;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem)
+{
+    (void)sem;
+    return pdTRUE;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    while (ticks--) {
+        i2c_sim_tick();
+    }
+}
+
+/*
+ * The byte-at-a-time PSoC calls behind the blocking API.  Any of them
+ * running while the simulated bus is busy is a collision.
+ */
+static uint8 polled(void)
+{
+    if (i2c_sim_active()) {
+        collisions++;
+    }
+    return 0;
+}
+
+uint8 I2C_MasterSendStart(uint8 addr, uint8 read)
+{
+    (void)addr;
+    (void)read;
+    return polled();
+}
+
+uint8 I2C_MasterSendRestart(uint8 addr, uint8 read)
+{
+    (void)addr;
+    (void)read;
+    return polled();
+}
+
+uint8 I2C_MasterSendStop(void)
+{
+    return polled();
+}
+
+uint8 I2C_MasterWriteByte(uint8 value)
+{
+    (void)value;
+    return polled();
+}
+
+uint8 I2C_MasterReadByte(uint8 ack)
+{
+    (void)ack;
+    return polled();
+}
+
+uint8 I2C_MasterWriteBuf(uint8 addr, uint8 *buffer, uint32 len, uint8 mode)
+{
+    (void)addr;
+    (void)buffer;
+    (void)len;
+    (void)mode;
+    return I2C_MSTR_NOT_READY;
+}
+
+uint32 I2C_MasterStatus(void)
+{
+    return 0;
+}
+
+uint32 I2C_MasterClearStatus(void)
+{
+    return 0;
+}
+
+// Every logged transaction goes to ADDR, starts with REGNUM and fits the
+// staging buffer, and their data joined up is pattern[0..len-1]
+static void check_log(const char *what, uint16 len)
+{
+    uint16 txns = i2c_sim_txn_count();
+    uint16 got = 0;
+    uint16 i;
+
+    check(txns == (len + I2C_TX_BUFFER_SIZE - 2) / (I2C_TX_BUFFER_SIZE - 1),
+          "%s %u: %u transactions", what, len, txns);
+
+    for (i = 0; i < txns; i++) {
+        uint8 addr;
+        uint16 n;
+        const uint8 *data = i2c_sim_txn(i, &addr, &n);
+
+        check(addr == ADDR, "%s %u: txn %u to 0x%02X", what, len, i, addr);
+        check(n > 1 && n <= I2C_TX_BUFFER_SIZE, "%s %u: txn %u is %u bytes", what, len, i, n);
+        check(data[0] == REGNUM, "%s %u: txn %u register 0x%02X", what, len, i, data[0]);
+        if (n < 2 || got + n - 1 > len) {
+            check(0, "%s %u: txn %u runs past the data", what, len, i);
+            return;
+        }
+        check(!memcmp(data + 1, &pattern[got], n - 1),
+              "%s %u: txn %u data out of order or corrupt", what, len, i);
+        got += n - 1;
+    }
+    check(got == len, "%s %u: %u bytes arrived", what, len, got);
+}
+
+static void test_stream(uint16 len, uint16 piece)
+{
+    uint16 i;
+
+    i2c_sim_reset();
+    i2c_register_stream_begin(ADDR, REGNUM);
+    for (i = 0; i < len; i += piece) {
+        i2c_register_stream_write(&pattern[i], min(piece, len - i));
+    }
+    check(i2c_register_stream_end() == I2C_XFER_OK, "stream %u: end failed", len);
+    check_log("stream", len);
+}
+
+static void test_async(uint16 len)
+{
+    i2c_sim_reset();
+    i2c_register_write_buffer_async(ADDR, REGNUM, pattern, len);
+    check(i2c_register_wait() == I2C_XFER_OK, "async %u: wait failed", len);
+    check_log("async", len);
+}
+
+int main(void)
+{
+    static const uint16 lengths[] = {
+        1, I2C_TX_BUFFER_SIZE - 2, I2C_TX_BUFFER_SIZE - 1, I2C_TX_BUFFER_SIZE,
+        3 * (I2C_TX_BUFFER_SIZE - 1) + 5, sizeof(pattern),
+    };
+    uint16 i;
+
+    for (i = 0; i < sizeof(pattern); i++) {
+        pattern[i] = (uint8)(i * 7 + (i >> 8));
+    }
+    i2c_set_hw(&i2c_sim_hw);
+
+    for (i = 0; i < NELEMS(lengths); i++) {
+        test_stream(lengths[i], 1);
+        test_stream(lengths[i], 7);
+        test_stream(lengths[i], lengths[i]);
+        test_async(lengths[i]);
+    }
+
+    // Starts refused with the bus busy are retried
+    i2c_sim_reset();
+    i2c_sim_busy_every(2);
+    i2c_register_write_buffer_async(ADDR, REGNUM, pattern, 600);
+    check(i2c_register_wait() == I2C_XFER_OK, "busy retry: wait failed");
+    check_log("busy retry", 600);
+
+    // A blocking call finishes the queued transfer before touching the bus
+    i2c_sim_reset();
+    collisions = 0;
+    i2c_register_write_buffer_async(ADDR, REGNUM, pattern, 600);
+    i2c_register_write(ADDR, 0x00, 0xAE);
+    check(collisions == 0, "blocking write: %u collisions", collisions);
+    check(i2c_register_wait() == I2C_XFER_OK, "blocking write: wait failed");
+    check_log("blocking write", 600);
+
+    // A NAK part way through fails the stream and drops the rest of it
+    i2c_sim_reset();
+    i2c_sim_nak_txn(2);
+    i2c_register_stream_begin(ADDR, REGNUM);
+    i2c_register_stream_write(pattern, 600);
+    check(i2c_register_stream_end() == I2C_XFER_ERROR, "nak: stream end didn't fail");
+    check(i2c_sim_txn_count() == 1, "nak: %u transactions went out", i2c_sim_txn_count());
+
+    // A bus that never comes free fails, and the next transfer is clean
+    i2c_sim_reset();
+    i2c_sim_busy_always(1);
+    i2c_register_write_buffer_async(ADDR, REGNUM, pattern, 10);
+    check(i2c_register_wait() == I2C_XFER_ERROR, "stuck bus: wait didn't fail");
+    i2c_sim_busy_always(0);
+    test_async(10);
+
+    printf("%s\n", failures ? "FAILED" : "ok");
+    return failures != 0;
+}